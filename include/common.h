@@ -8,11 +8,11 @@
 #include <fstream>
 #include <sstream>
 
+#include <rg/AssetPack.hpp>
+
 std::string readFileContents(std::string path) {
-    std::ifstream in(path);
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    return buffer.str();
+    AssetFile file(path);
+    return file.data() ? std::string(file.data(), file.size()) : std::string();
 }
 
 
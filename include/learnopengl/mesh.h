@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/GpuMemory.hpp>
 
 #include <string>
 #include <vector>
@@ -115,6 +116,8 @@ private:
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        GpuMemory::tracker().buffer(GPU_GEOMETRY, VBO, "Mesh vertices", vertices.size() * sizeof(Vertex));
+        GpuMemory::tracker().buffer(GPU_GEOMETRY, EBO, "Mesh indices", indices.size() * sizeof(unsigned int));
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -12,6 +12,9 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/AssetPack.hpp>
+#include <rg/GLDebug.hpp>
+#include <rg/GpuMemory.hpp>
 
 #include <string>
 #include <fstream>
@@ -40,6 +43,16 @@ public:
         loadModel(path);
     }
 
+    // empty model, filled by Load or by a loader that writes the meshes directly
+    Model() : gammaCorrection(false)
+    {
+    }
+
+    void Load(string const &path)
+    {
+        loadModel(path);
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -226,7 +239,8 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    AssetFile file(filename);
+    unsigned char *data = file.data() ? stbi_load_from_memory((const stbi_uc*)file.data(), (int)file.size(), &width, &height, &nrComponents, 0) : nullptr;
     if (data)
     {
         GLenum format;
@@ -239,6 +253,8 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        GL_DEBUG_LABEL(GL_TEXTURE, textureID, filename.c_str());
+        GpuMemory::tracker().texture(GPU_TEXTURES, textureID, filename.c_str(), format, width, height, 1, 1, true);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
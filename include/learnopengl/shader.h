@@ -9,6 +9,9 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/AssetPack.hpp>
+#include <rg/Trace.hpp>
+#include <rg/GLDebug.hpp>
 class Shader
 {
 public:
@@ -17,75 +20,33 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+        TraceScope scope("Shader");
+        // 1. retrieve the vertex/fragment source code, straight from the asset pack when one is mounted
+        AssetFile vShaderFile(vertexPath);
+        AssetFile fShaderFile(fragmentPath);
+        AssetFile gShaderFile;
+        if(geometryPath != nullptr)
+            gShaderFile.open(geometryPath);
+        if(!vShaderFile.data() || !fShaderFile.data() || (geometryPath != nullptr && !gShaderFile.data()))
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        // 2. compile shaders, the sources are passed with their lengths since they are not null terminated
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
+        compileSource(vertex, vShaderFile);
         checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
+        compileSource(fragment, fShaderFile);
         checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
         unsigned int geometry;
         if(geometryPath != nullptr)
         {
-            const char * gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
+            compileSource(geometry, gShaderFile);
             checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
@@ -96,6 +57,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        GL_DEBUG_LABEL(RG_GL_PROGRAM, ID, fragmentPath);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -169,6 +131,15 @@ public:
     }
 
 private:
+    // hands the source to GL without copying it into a string first
+    // ------------------------------------------------------------------------
+    void compileSource(GLuint shader, const AssetFile& source)
+    {
+        const GLchar* code = source.data() ? source.data() : "";
+        GLint length = (GLint)source.size();
+        glShaderSource(shader, 1, &code, &length);
+        glCompileShader(shader);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
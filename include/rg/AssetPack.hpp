@@ -0,0 +1,290 @@
+#ifndef MATF_RG_GAME_OMEGA_ASSETPACK_HPP
+#define MATF_RG_GAME_OMEGA_ASSETPACK_HPP
+
+#include "rg/MappedFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// "RGPK" read as a little endian word
+#define PACK_MAGIC 0x4b504752u
+#define PACK_VERSION 1u
+// payloads start on cache line boundaries, the mapping itself is page aligned
+#define PACK_ALIGNMENT 64
+#define PACK_COMPRESSED 1u
+
+#define PACK_MIN_MATCH 4
+#define PACK_MAX_OFFSET 65535
+#define PACK_HASH_BITS 14
+
+// Archive layout, all little endian:
+//  header  - u32 magic, u32 version, u32 entry count, u32 name bytes
+//  entries - PackEntry per file, sorted by name
+//  names   - the entry names back to back, not terminated
+//  data    - payloads, each aligned to PACK_ALIGNMENT from the start of the file
+struct PackEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t rawSize;
+    uint32_t nameOffset;
+    uint16_t nameLength;
+    uint16_t flags;
+};
+
+struct AssetSpan {
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+// LZ77 byte codec in the style of an LZ4 block. A sequence is a token with the literal count in
+// the high and the match length minus PACK_MIN_MATCH in the low nibble, a nibble of 15 continues
+// in extra bytes that are added up until one is below 255. The literals follow, then a u16 offset
+// back into the output and the extra match length bytes. The last sequence has literals only.
+class PackCodec {
+public:
+    static void compress(const char* source, size_t size, std::vector<char>& out){
+        out.clear();
+        std::vector<int64_t> table((size_t)1 << PACK_HASH_BITS, -1);
+        size_t anchor = 0;
+        size_t i = 0;
+        while(i + PACK_MIN_MATCH <= size){
+            uint32_t sequence;
+            std::memcpy(&sequence, source + i, sizeof(sequence));
+            uint32_t hash = (sequence * 2654435761u) >> (32 - PACK_HASH_BITS);
+            int64_t candidate = table[hash];
+            table[hash] = i;
+            if(candidate < 0 || i - candidate > PACK_MAX_OFFSET || std::memcmp(source + candidate, source + i, PACK_MIN_MATCH) != 0){
+                ++i;
+                continue;
+            }
+            size_t length = PACK_MIN_MATCH;
+            while(i + length < size && source[candidate + length] == source[i + length])
+                ++length;
+            writeSequence(out, source + anchor, i - anchor, i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+        writeSequence(out, source + anchor, size - anchor, 0, 0);
+    }
+
+    // false if the data is corrupt or does not expand to exactly rawSize bytes
+    static bool decompress(const char* source, size_t size, char* out, size_t rawSize){
+        const unsigned char* in = (const unsigned char*)source;
+        const unsigned char* end = in + size;
+        size_t written = 0;
+        while(in < end){
+            unsigned int token = *in++;
+            size_t literals = token >> 4;
+            if(!readLength(in, end, literals) || literals > (size_t)(end - in) || literals > rawSize - written)
+                return false;
+            std::memcpy(out + written, in, literals);
+            in += literals;
+            written += literals;
+            if(in == end)
+                break;
+            if(end - in < 2)
+                return false;
+            size_t offset = in[0] | (in[1] << 8);
+            in += 2;
+            size_t length = token & 15;
+            if(!readLength(in, end, length))
+                return false;
+            length += PACK_MIN_MATCH;
+            if(offset == 0 || offset > written || length > rawSize - written)
+                return false;
+            // byte by byte because the match may overlap what it is copying
+            for(size_t j = 0; j < length; ++j, ++written)
+                out[written] = out[written - offset];
+        }
+        return written == rawSize;
+    }
+
+private:
+    static void writeLength(std::vector<char>& out, size_t length){
+        for(length -= 15; length >= 255; length -= 255)
+            out.push_back((char)255);
+        out.push_back((char)length);
+    }
+
+    static bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length){
+        if(length != 15)
+            return true;
+        unsigned int byte;
+        do {
+            if(in == end)
+                return false;
+            byte = *in++;
+            length += byte;
+        } while(byte == 255);
+        return true;
+    }
+
+    static void writeSequence(std::vector<char>& out, const char* literals, size_t literalCount, size_t offset, size_t matchLength){
+        size_t match = matchLength ? matchLength - PACK_MIN_MATCH : 0;
+        out.push_back((char)((std::min(literalCount, (size_t)15) << 4) | std::min(match, (size_t)15)));
+        if(literalCount >= 15)
+            writeLength(out, literalCount);
+        out.insert(out.end(), literals, literals + literalCount);
+        if(!matchLength)
+            return;
+        out.push_back((char)(offset & 0xFF));
+        out.push_back((char)(offset >> 8));
+        if(match >= 15)
+            writeLength(out, match);
+    }
+};
+
+// Read only archive made by tools/asset_packer, mapped once and searched by name. Stored entries
+// are handed out as spans straight into the mapping, compressed ones are expanded the first time
+// they are asked for and kept until the pack is closed.
+class AssetPack {
+public:
+    bool open(const std::string& path){
+        close();
+        if(!file.open(path))
+            return false;
+        uint32_t header[4];
+        if(file.size() < sizeof(header)){
+            std::cerr << "ERROR::ASSET_PACK " << path << " is too small" << std::endl;
+            return fail();
+        }
+        std::memcpy(header, file.data(), sizeof(header));
+        if(header[0] != PACK_MAGIC || header[1] != PACK_VERSION){
+            std::cerr << "ERROR::ASSET_PACK " << path << " is not a version " << PACK_VERSION << " pack" << std::endl;
+            return fail();
+        }
+        uint64_t namesStart = sizeof(header) + (uint64_t)header[2] * sizeof(PackEntry);
+        if(namesStart + header[3] > file.size()){
+            std::cerr << "ERROR::ASSET_PACK " << path << " has a broken index" << std::endl;
+            return fail();
+        }
+        entries.resize(header[2]);
+        std::memcpy(entries.data(), file.data() + sizeof(header), entries.size() * sizeof(PackEntry));
+        names = file.data() + namesStart;
+        for(const PackEntry& entry : entries){
+            if(entry.nameOffset + (uint64_t)entry.nameLength > header[3] || entry.offset > file.size() || entry.size > file.size() - entry.offset){
+                std::cerr << "ERROR::ASSET_PACK " << path << " has a broken entry" << std::endl;
+                return fail();
+            }
+        }
+        expanded.resize(entries.size());
+        return true;
+    }
+
+    void close(){
+        std::lock_guard<std::mutex> lock(expandMutex);
+        file.close();
+        entries.clear();
+        expanded.clear();
+        names = nullptr;
+    }
+
+    bool isOpen() const {
+        return file.data() != nullptr;
+    }
+
+    size_t entryCount() const {
+        return entries.size();
+    }
+
+    // binary search of the sorted index, safe to call from several threads at once
+    bool find(const std::string& name, AssetSpan& span){
+        auto entry = std::lower_bound(entries.begin(), entries.end(), name, [this](const PackEntry& entry, const std::string& key){
+            return compareName(entry, key) < 0;
+        });
+        if(entry == entries.end() || compareName(*entry, name) != 0)
+            return false;
+        const char* payload = file.data() + entry->offset;
+        if(!(entry->flags & PACK_COMPRESSED)){
+            span.data = payload;
+            span.size = entry->size;
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(expandMutex);
+        std::unique_ptr<std::vector<char>>& bytes = expanded[entry - entries.begin()];
+        if(!bytes){
+            std::unique_ptr<std::vector<char>> raw(new std::vector<char>(entry->rawSize));
+            if(!PackCodec::decompress(payload, entry->size, raw->data(), raw->size())){
+                std::cerr << "ERROR::ASSET_PACK could not decompress " << name << std::endl;
+                return false;
+            }
+            bytes = std::move(raw);
+        }
+        span.data = bytes->data();
+        span.size = bytes->size();
+        return true;
+    }
+
+    // the pack every asset load looks in first, null when assets are read from loose files
+    static AssetPack*& mounted(){
+        static AssetPack* pack = nullptr;
+        return pack;
+    }
+
+private:
+    MappedFile file;
+    std::vector<PackEntry> entries;
+    const char* names = nullptr;
+    std::mutex expandMutex;
+    std::vector<std::unique_ptr<std::vector<char>>> expanded;
+
+    bool fail(){
+        file.close();
+        entries.clear();
+        return false;
+    }
+
+    int compareName(const PackEntry& entry, const std::string& key) const {
+        size_t length = std::min((size_t)entry.nameLength, key.size());
+        int order = std::memcmp(names + entry.nameOffset, key.data(), length);
+        if(order != 0)
+            return order;
+        return entry.nameLength < key.size() ? -1 : (entry.nameLength > key.size() ? 1 : 0);
+    }
+};
+
+// Bytes of one asset, taken from the mounted pack or mapped from the loose file under the same path
+class AssetFile {
+public:
+    AssetFile() = default;
+
+    explicit AssetFile(const std::string& path){
+        open(path);
+    }
+
+    AssetFile(const AssetFile&) = delete;
+    AssetFile& operator=(const AssetFile&) = delete;
+
+    bool open(const std::string& path){
+        loose.close();
+        span = AssetSpan();
+        AssetPack* pack = AssetPack::mounted();
+        if(pack && pack->find(path, span))
+            return true;
+        if(!loose.open(path))
+            return false;
+        span.data = loose.data();
+        span.size = loose.size();
+        return true;
+    }
+
+    const char* data() const {
+        return span.data;
+    }
+
+    size_t size() const {
+        return span.size;
+    }
+
+private:
+    MappedFile loose;
+    AssetSpan span;
+};
+
+#endif //MATF_RG_GAME_OMEGA_ASSETPACK_HPP
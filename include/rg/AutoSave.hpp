@@ -0,0 +1,127 @@
+#ifndef MATF_RG_GAME_OMEGA_AUTOSAVE_HPP
+#define MATF_RG_GAME_OMEGA_AUTOSAVE_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Writes a file from its own thread. Callers hand over a function that serialises a copy of
+// their state, a newer one replaces whatever is still waiting, so however often it is called
+// the file is written at most once per interval. The caller only ever takes the lock for the
+// swap, the serialising and the disk I/O happen outside of it.
+class AutoSave {
+public:
+    ~AutoSave(){
+        stop();
+    }
+
+    void start(const std::string& path, double intervalSeconds){
+        if(thread.joinable())
+            return;
+        this->path = path;
+        interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(intervalSeconds));
+        running = true;
+        thread = std::thread([this](){ run(); });
+    }
+
+    void submit(std::function<std::string()> snapshot){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = std::move(snapshot);
+        }
+        wake.notify_one();
+    }
+
+    // writes what is still pending right away and returns once it is on disk
+    void stop(){
+        if(!thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    unsigned int writeCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return writes;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::string path;
+    Clock::duration interval;
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::function<std::string()> pending;
+    bool running = false;
+    unsigned int writes = 0;
+    // what is on disk, saves that would not change it are skipped
+    std::string written;
+
+    void run(){
+        Clock::time_point lastWrite = Clock::now() - interval;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true){
+            wake.wait(lock, [this](){ return pending || !running; });
+            // later snapshots replace this one while the interval runs out
+            wake.wait_until(lock, lastWrite + interval, [this](){ return !running; });
+            std::function<std::string()> snapshot;
+            snapshot.swap(pending);
+            bool stopping = !running;
+            lock.unlock();
+            if(snapshot){
+                std::string contents = snapshot();
+                if(contents != written && writeFile(contents)){
+                    written.swap(contents);
+                    lastWrite = Clock::now();
+                    lock.lock();
+                    writes++;
+                    lock.unlock();
+                }
+            }
+            if(stopping)
+                return;
+            lock.lock();
+        }
+    }
+
+    // the old file is only replaced once the new one is completely on disk
+    bool writeFile(const std::string& contents){
+        std::string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0){
+            std::cerr << "ERROR::AUTOSAVE could not write " << temporary << std::endl;
+            return false;
+        }
+        size_t done = 0;
+        while(done < contents.size()){
+            ssize_t count = ::write(fd, contents.data() + done, contents.size() - done);
+            if(count <= 0)
+                break;
+            done += count;
+        }
+        bool ok = done == contents.size() && fsync(fd) == 0;
+        ::close(fd);
+        if(!ok || std::rename(temporary.c_str(), path.c_str()) != 0){
+            std::cerr << "ERROR::AUTOSAVE could not replace " << path << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_AUTOSAVE_HPP
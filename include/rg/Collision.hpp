@@ -0,0 +1,103 @@
+#ifndef MATF_RG_GAME_OMEGA_COLLISION_HPP
+#define MATF_RG_GAME_OMEGA_COLLISION_HPP
+
+#include "rg/Cube.hpp"
+#include "rg/Track.hpp"
+#include "rg/JobSystem.hpp"
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+// an obstacle whose z is inside [front, back) of the player's lane hits the player
+#define COLLISION_ZONE_FRONT -1.2f
+// obstacles past this are behind the player and count as passed
+#define COLLISION_ZONE_BACK -0.29f
+// the normal three lanes are moved on the calling thread
+#define COLLISION_LANES_PER_JOB 4
+
+// Obstacles kept in one bucket per lane. Rows are spawned front to back at the same speed,
+// so every bucket stays ordered nearest first and passed obstacles leave from its front.
+class ObstacleLanes {
+public:
+    explicit ObstacleLanes(unsigned int laneCount = TRACK_LANES) : lanes(laneCount) {
+    }
+
+    ~ObstacleLanes(){
+        clear();
+    }
+
+    void add(unsigned int lane, Cube* cube){
+        lanes[lane].push_back(cube);
+        count++;
+    }
+
+    void clear(){
+        for(std::deque<Cube*>& lane : lanes){
+            for(Cube* cube : lane)
+                delete cube;
+            lane.clear();
+        }
+        count = 0;
+    }
+
+    // drops all obstacles
+    void setLanes(unsigned int laneCount){
+        clear();
+        lanes.resize(laneCount);
+    }
+
+    unsigned int size() const {
+        return count;
+    }
+
+    // true if an obstacle of the lane is inside the hit zone at any point while moving by distance.
+    // The whole swept interval is tested so a long frame can't carry an obstacle past the player.
+    bool sweep(unsigned int lane, float distance) const {
+        for(Cube* cube : lanes[lane]){
+            float start = cube->zPos();
+            float end = start + distance;
+            // the rest of the bucket is even farther away
+            if(end < COLLISION_ZONE_FRONT)
+                return false;
+            if(start < COLLISION_ZONE_BACK)
+                return true;
+        }
+        return false;
+    }
+
+    // moves all obstacles by distance, returns how many got past the player and were removed.
+    // Lanes don't share anything so groups of them are moved as separate jobs.
+    unsigned int advance(float distance, JobSystem& jobs){
+        std::atomic<unsigned int> passed{0};
+        jobs.parallelFor(0, lanes.size(), COLLISION_LANES_PER_JOB, [&](unsigned int first, unsigned int last){
+            unsigned int lanePassed = 0;
+            for(unsigned int i = first; i < last; ++i){
+                std::deque<Cube*>& lane = lanes[i];
+                for(Cube* cube : lane)
+                    cube->translate(cube->xPos(), 0.0f, cube->zPos() + distance);
+                while(!lane.empty() && lane.front()->zPos() >= COLLISION_ZONE_BACK){
+                    delete lane.front();
+                    lane.pop_front();
+                    lanePassed++;
+                }
+            }
+            passed.fetch_add(lanePassed, std::memory_order_relaxed);
+        });
+        count -= passed.load();
+        return passed.load();
+    }
+
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        for(const std::deque<Cube*>& lane : lanes)
+            for(Cube* cube : lane)
+                fn(cube);
+    }
+
+private:
+    std::vector<std::deque<Cube*>> lanes;
+    unsigned int count = 0;
+};
+
+#endif //MATF_RG_GAME_OMEGA_COLLISION_HPP
@@ -0,0 +1,205 @@
+#ifndef MATF_RG_GAME_OMEGA_DEFERREDRENDERER_HPP
+#define MATF_RG_GAME_OMEGA_DEFERREDRENDERER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include "rg/GLDebug.hpp"
+#include "rg/GpuMemory.hpp"
+
+#include "rg/Lights.hpp"
+#include "rg/LightCluster.hpp"
+#include "rg/ShadowMaps.hpp"
+
+#include <cmath>
+#include <iostream>
+
+// Geometry is written once into a compact G-buffer:
+//  0 - SRGB8_ALPHA8 albedo and specular strength
+//  1 - RGB10_A2 octahedral normal and shininess / 256
+//  depth - DEPTH24_STENCIL8 texture, positions are reconstructed from it
+// Lights are then added to the target one screen space pass each, bounded by the
+// scissor rectangle of the light's sphere of influence.
+class DeferredRenderer {
+public:
+    DeferredRenderer(unsigned int width, unsigned int height, unsigned int quadVAO)
+            : lightingShader("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs"),
+              width(width), height(height), quadVAO(quadVAO) {
+        glGenFramebuffers(1, &gBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+
+        glGenTextures(3, textures);
+        const GLenum internalFormats[] = {GL_SRGB8_ALPHA8, GL_RGB10_A2};
+        for(unsigned int i = 0; i < 2; ++i){
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+        }
+        unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+
+        glBindTexture(GL_TEXTURE_2D, textures[2]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, textures[2], 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::GBUFFER_FRAMEBUFFER incomplete" << std::endl;
+        GL_DEBUG_LABEL(GL_FRAMEBUFFER, gBuffer, "G-buffer");
+        GL_DEBUG_LABEL(GL_TEXTURE, textures[0], "G-buffer albedo");
+        GL_DEBUG_LABEL(GL_TEXTURE, textures[1], "G-buffer normal");
+        GL_DEBUG_LABEL(GL_TEXTURE, textures[2], "G-buffer depth");
+        GpuMemory::tracker().texture(GPU_RENDER_TARGETS, textures[0], "G-buffer albedo", internalFormats[0], width, height);
+        GpuMemory::tracker().texture(GPU_RENDER_TARGETS, textures[1], "G-buffer normal", internalFormats[1], width, height);
+        GpuMemory::tracker().texture(GPU_RENDER_TARGETS, textures[2], "G-buffer depth", GL_DEPTH24_STENCIL8, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~DeferredRenderer(){
+        for(unsigned int i = 0; i < 3; ++i)
+            GpuMemory::tracker().release(GPU_TEXTURE, textures[i]);
+        glDeleteTextures(3, textures);
+        glDeleteFramebuffers(1, &gBuffer);
+    }
+
+    void beginGeometryPass(){
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        // G-buffer attributes must not be blended, the albedo target encodes to sRGB on write
+        glDisable(GL_BLEND);
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+
+    void endGeometryPass(){
+        glDisable(GL_FRAMEBUFFER_SRGB);
+        glEnable(GL_BLEND);
+    }
+
+    // adds all lights into the color attachment 0 of the currently bound framebuffer
+    void lightingPass(const glm::mat4& view, const glm::mat4& projection, float fovY, float zNear, float zFar,
+                      const glm::vec3& viewPos, const DirLight& dirLight, const PointLight& pointLight,
+                      const SpotLight& spotLight, const LightCluster* cluster, ShadowMaps* shadows){
+        this->view = view;
+        tanY = std::tan(fovY * 0.5f);
+        tanX = tanY * (float)width / (float)height;
+        this->zNear = zNear;
+        this->zFar = zFar;
+        passes = 0;
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        for(unsigned int i = 0; i < 3; ++i){
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        lightingShader.use();
+        lightingShader.setInt("gAlbedoSpecular", 0);
+        lightingShader.setInt("gNormalShininess", 1);
+        lightingShader.setInt("gDepth", 2);
+        lightingShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        lightingShader.setMat4("view", view);
+        lightingShader.setVec3("viewPos", viewPos);
+        if(shadows)
+            shadows->bind(lightingShader, true);
+        else
+            lightingShader.setBool("shadowsEnabled", false);
+        glBindVertexArray(quadVAO);
+
+        lightingShader.setInt("lightType", 0);
+        lightingShader.setVec3("light.direction", dirLight.direction);
+        lightingShader.setVec3("light.ambient", dirLight.ambient);
+        lightingShader.setVec3("light.diffuse", dirLight.diffuse);
+        lightingShader.setVec3("light.specular", dirLight.specular);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        glEnable(GL_SCISSOR_TEST);
+        ClusteredLight light = ClusteredLight();
+        light.position = pointLight.position;
+        light.diffuse = pointLight.diffuse;
+        light.specular = pointLight.specular;
+        light.constant = pointLight.constant;
+        light.linear = pointLight.linear;
+        light.quadratic = pointLight.quadratic;
+        light.spot = false;
+        drawLight(light, pointLight.ambient, false);
+
+        light.position = spotLight.position;
+        light.direction = spotLight.direction;
+        light.diffuse = spotLight.diffuse;
+        light.specular = spotLight.specular;
+        light.constant = spotLight.constant;
+        light.linear = spotLight.linear;
+        light.quadratic = spotLight.quadratic;
+        light.cutOff = spotLight.cutOff;
+        light.outerCutOff = spotLight.outerCutOff;
+        light.spot = true;
+        drawLight(light, spotLight.ambient, false);
+
+        if(cluster){
+            for(const ClusteredLight& trackLight : cluster->getLights())
+                drawLight(trackLight, glm::vec3(0.0f), true);
+        }
+        glDisable(GL_SCISSOR_TEST);
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    unsigned int lightPasses() const {
+        return passes;
+    }
+
+private:
+    Shader lightingShader;
+    unsigned int gBuffer;
+    unsigned int textures[3];
+    unsigned int width;
+    unsigned int height;
+    unsigned int quadVAO;
+    unsigned int passes = 0;
+
+    glm::mat4 view;
+    float tanX, tanY;
+    float zNear, zFar;
+
+    void drawLight(const ClusteredLight& light, const glm::vec3& ambient, bool windowed){
+        float radius = LightCluster::lightRadius(light);
+        LightCluster::SphereBounds bounds;
+        if(!LightCluster::sphereBounds(view, light.position, radius, tanX, tanY, zNear, zFar, bounds))
+            return;
+
+        int x0 = (int)std::floor((std::max(bounds.minX, -1.0f) * 0.5f + 0.5f) * width);
+        int y0 = (int)std::floor((std::max(bounds.minY, -1.0f) * 0.5f + 0.5f) * height);
+        int x1 = (int)std::ceil((std::min(bounds.maxX, 1.0f) * 0.5f + 0.5f) * width);
+        int y1 = (int)std::ceil((std::min(bounds.maxY, 1.0f) * 0.5f + 0.5f) * height);
+        if(x1 <= x0 || y1 <= y0)
+            return;
+        glScissor(x0, y0, x1 - x0, y1 - y0);
+
+        lightingShader.setInt("lightType", light.spot ? 2 : 1);
+        lightingShader.setVec3("light.position", light.position);
+        lightingShader.setVec3("light.direction", light.direction);
+        lightingShader.setVec3("light.ambient", ambient);
+        lightingShader.setVec3("light.diffuse", light.diffuse);
+        lightingShader.setVec3("light.specular", light.specular);
+        lightingShader.setFloat("light.constant", light.constant);
+        lightingShader.setFloat("light.linear", light.linear);
+        lightingShader.setFloat("light.quadratic", light.quadratic);
+        lightingShader.setFloat("light.cutOff", light.cutOff);
+        lightingShader.setFloat("light.outerCutOff", light.outerCutOff);
+        lightingShader.setFloat("light.radius", radius);
+        lightingShader.setBool("light.windowed", windowed);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        passes++;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_DEFERREDRENDERER_HPP
@@ -7,12 +7,18 @@
 
 #include <iostream>
 #include <glad/glad.h>
+#include <rg/GLDebug.hpp>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+// errors come from the KHR_debug callback when it is installed, glGetError is only polled without it
+#if RG_GL_DEBUG
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ if (GL_DEBUG_ACTIVE()) { x; break; } rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+#else
+#define GLCALL(x) do{ x; } while (0)
+#endif
 
 namespace rg {
 
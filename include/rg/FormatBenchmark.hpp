@@ -0,0 +1,140 @@
+#ifndef MATF_RG_GAME_OMEGA_FORMATBENCHMARK_HPP
+#define MATF_RG_GAME_OMEGA_FORMATBENCHMARK_HPP
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include "rg/RenderFormats.hpp"
+#include "rg/RenderGraph.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define FORMAT_BENCHMARK_WARMUP 10
+#define FORMAT_BENCHMARK_FRAMES 100
+
+// Times the post-processing chain, filling the scene target, the downsampled bloom blur steps
+// and the composite, in every target format at a few resolutions, offscreen so the window size doesn't
+// matter. The scene stays RGBA16F for a format that clamps. GPU time comes from GL_TIME_ELAPSED
+// queries, memory is what the chain's render graph allocates.
+class FormatBenchmark {
+public:
+    FormatBenchmark(Shader& blurShader, Shader& screenShader, unsigned int quadVAO, unsigned int sourceTexture, unsigned int blurSteps,
+                    int downsample)
+            : blurShader(blurShader), screenShader(screenShader), quadVAO(quadVAO), sourceTexture(sourceTexture),
+              blurSteps(blurSteps), downsample(downsample) {}
+
+    // prints a line per format and resolution and writes them to the CSV file
+    bool run(RenderFormats& formats, const std::string& csvPath){
+        std::ofstream csv(csvPath, std::ios::trunc);
+        if(!csv){
+            std::cerr << "ERROR::FORMAT_BENCHMARK could not write " << csvPath << std::endl;
+            return false;
+        }
+        csv << "scene_format,bloom_format,width,height,gpu_ms,target_mb\n";
+        const int resolutions[][2] = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+        for(const int* resolution : resolutions){
+            for(int format = 0; format < FORMAT_COUNT; ++format){
+                // the scene keeps RGBA16F where the format would clamp it, like in the game
+                int scene = formats.resolve(format, false, true);
+                int bloom = formats.resolve(format, false);
+                uint64_t bytes = 0;
+                double ms = measure(RenderFormats::internalFormat(scene), RenderFormats::internalFormat(bloom),
+                                    resolution[0], resolution[1], bytes);
+                csv << RenderFormats::name(scene) << ',' << RenderFormats::name(bloom) << ',' << resolution[0] << ','
+                    << resolution[1] << ',' << ms << ',' << bytes / GPU_MEMORY_MB << '\n';
+                std::cout << RenderFormats::name(scene) << "/" << RenderFormats::name(bloom) << " " << resolution[0] << "x"
+                          << resolution[1] << ": " << ms << " ms, " << bytes / GPU_MEMORY_MB << " MB" << std::endl;
+            }
+        }
+        return true;
+    }
+
+private:
+    Shader& blurShader;
+    Shader& screenShader;
+    unsigned int quadVAO;
+    unsigned int sourceTexture;
+    unsigned int blurSteps;
+    int downsample;
+
+    double measure(GLenum sceneFormat, GLenum bloomFormat, int width, int height, uint64_t& bytes){
+        RenderGraph graph;
+        const RenderTargetDesc hdrTarget = {sceneFormat, width, height};
+        const RenderTargetDesc bloomTarget = {bloomFormat, width / downsample, height / downsample};
+        const RenderTargetDesc outputTarget = {GL_RGBA8, width, height};
+        int scene = graph.createTexture("Scene color", hdrTarget);
+        int output = graph.createTexture("Output", outputTarget);
+        graph.markOutput(output);
+        graph.addPass("Scene", {}, {scene}, [&](){
+            blurShader.use();
+            blurShader.setInt("image", 0);
+            blurShader.setInt("horizontal", true);
+            blurShader.setVec2("texelSize", 1.0f / width, 1.0f / height);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, sourceTexture);
+            drawQuad();
+        });
+        int blurred = scene;
+        for(unsigned int i = 0; i < blurSteps; ++i){
+            int source = blurred;
+            bool horizontal = i % 2 == 0;
+            blurred = graph.createTexture("Bloom blur", bloomTarget);
+            graph.addPass("Bloom blur", {source}, {blurred}, [&, i, source, horizontal](){
+                if(i == 0){
+                    glViewport(0, 0, width / downsample, height / downsample);
+                    blurShader.setVec2("texelSize", 1.0f / (width / downsample), 1.0f / (height / downsample));
+                }
+                blurShader.setInt("horizontal", horizontal);
+                glBindTexture(GL_TEXTURE_2D, graph.texture(source));
+                drawQuad();
+            });
+        }
+        graph.addPass("Composite", {scene, blurred}, {output}, [&](){
+            glViewport(0, 0, width, height);
+            screenShader.use();
+            screenShader.setInt("scene", 0);
+            screenShader.setInt("bloomBlur", 1);
+            screenShader.setInt("bloom", true);
+            screenShader.setFloat("exposure", 1.0f);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.texture(scene));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, graph.texture(blurred));
+            drawQuad();
+            glActiveTexture(GL_TEXTURE0);
+        });
+        graph.compile();
+        bytes = graph.targetBytes();
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glViewport(0, 0, width, height);
+        std::vector<GLuint> queries(FORMAT_BENCHMARK_FRAMES);
+        glGenQueries(queries.size(), queries.data());
+        for(int frame = -FORMAT_BENCHMARK_WARMUP; frame < FORMAT_BENCHMARK_FRAMES; ++frame){
+            if(frame >= 0)
+                glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+            graph.execute(nullptr);
+            if(frame >= 0)
+                glEndQuery(GL_TIME_ELAPSED);
+        }
+        GLuint64 total = 0;
+        for(GLuint query : queries){
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            total += elapsed;
+        }
+        glDeleteQueries(queries.size(), queries.data());
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return total / 1.0e6 / FORMAT_BENCHMARK_FRAMES;
+    }
+
+    void drawQuad(){
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_FORMATBENCHMARK_HPP
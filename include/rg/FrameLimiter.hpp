@@ -0,0 +1,66 @@
+#ifndef MATF_RG_GAME_OMEGA_FRAMELIMITER_HPP
+#define MATF_RG_GAME_OMEGA_FRAMELIMITER_HPP
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <thread>
+
+// the end of a wait is spun since sleeps can overshoot by about this much
+#define FRAME_LIMITER_SPIN_MS 1.0
+// frame rate while the window is in the background
+#define FRAME_LIMITER_IDLE_FPS 10
+
+enum VsyncMode {
+    VSYNC_OFF,
+    VSYNC_ON,
+    // late frames are shown right away instead of waiting for the next vblank, needs swap_control_tear
+    VSYNC_ADAPTIVE
+};
+
+// Paces the render loop. Frames are held back to a fixed cadence by sleeping most of the way to
+// the next deadline and spinning the rest, deadlines follow from the previous one so waits
+// don't add up drift. A frame that is late by a whole interval starts a new cadence instead
+// of rushing the following frames to catch up.
+class FrameLimiter {
+public:
+    // takes effect on the context that is current, only calls into GLFW when the mode changes
+    void setVsync(int mode){
+        if(mode == vsyncMode)
+            return;
+        vsyncMode = mode;
+        int interval = mode == VSYNC_OFF ? 0 : 1;
+        if(mode == VSYNC_ADAPTIVE && (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear")))
+            interval = -1;
+        glfwSwapInterval(interval);
+    }
+
+    // call before the swap, fps of 0 or less returns right away. Without precise timing it only
+    // sleeps, which is what an idle window wants.
+    void wait(double fps, bool precise = true){
+        Clock::time_point now = Clock::now();
+        if(fps <= 0.0){
+            deadline = now;
+            return;
+        }
+        Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+        deadline += interval;
+        if(now - deadline > interval || deadline - now > interval){
+            deadline = now;
+            return;
+        }
+        Clock::duration spin = precise ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(FRAME_LIMITER_SPIN_MS)) : Clock::duration::zero();
+        if(deadline - now > spin)
+            std::this_thread::sleep_for(deadline - now - spin);
+        while(Clock::now() < deadline)
+            ;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int vsyncMode = -1;
+    Clock::time_point deadline = Clock::now();
+};
+
+#endif //MATF_RG_GAME_OMEGA_FRAMELIMITER_HPP
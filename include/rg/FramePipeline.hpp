@@ -0,0 +1,136 @@
+#ifndef MATF_RG_GAME_OMEGA_FRAMEPIPELINE_HPP
+#define MATF_RG_GAME_OMEGA_FRAMEPIPELINE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Single producer, single consumer ring. N has to be a power of two.
+template<typename T, unsigned int N>
+class SpscQueue {
+public:
+    bool push(const T& value){
+        unsigned int tail = writeIndex.load(std::memory_order_relaxed);
+        if(tail - readIndex.load(std::memory_order_acquire) == N)
+            return false;
+        items[tail & (N - 1)] = value;
+        writeIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value){
+        unsigned int head = readIndex.load(std::memory_order_relaxed);
+        if(head == writeIndex.load(std::memory_order_acquire))
+            return false;
+        value = items[head & (N - 1)];
+        readIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    std::atomic<unsigned int> writeIndex{0};
+    std::atomic<unsigned int> readIndex{0};
+};
+
+// Three copies of a value, the writer fills one while the reader keeps another and the third
+// is handed between them with a single atomic exchange. Neither side ever waits on the other.
+template<typename T>
+class TripleBuffer {
+public:
+    // the copy only the writer touches
+    T& back(){
+        return slots[backIndex];
+    }
+
+    void publish(){
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // switches to the newest published copy, false if nothing was published since the last call
+    bool update(){
+        if(!(middle.load(std::memory_order_acquire) & FRESH))
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // the copy only the reader touches
+    const T& front() const {
+        return slots[frontIndex];
+    }
+
+private:
+    static const unsigned int FRESH = 4;
+    static const unsigned int INDEX = 3;
+
+    T slots[3];
+    unsigned int backIndex = 0;
+    unsigned int frontIndex = 1;
+    std::atomic<unsigned int> middle{2};
+};
+
+// Runs a step function on its own thread every time it is kicked. The mutex is only there to
+// let the thread sleep between kicks, no data goes through it.
+class PipelineWorker {
+public:
+    ~PipelineWorker(){
+        stop();
+    }
+
+    void start(std::function<void()> step){
+        if(thread.joinable())
+            return;
+        this->step = step;
+        running = true;
+        thread = std::thread([this](){
+            std::unique_lock<std::mutex> lock(mutex);
+            while(running){
+                wake.wait(lock, [this](){ return kicked || !running; });
+                // a kick that arrived with the stop is dropped, the last step is the last one started
+                if(!running)
+                    break;
+                kicked = false;
+                lock.unlock();
+                this->step();
+                lock.lock();
+            }
+        });
+    }
+
+    void kick(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            kicked = true;
+        }
+        wake.notify_one();
+    }
+
+    // returns once the step in progress, if any, has finished, no step starts after it
+    void stop(){
+        if(!thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    bool active() const {
+        return thread.joinable();
+    }
+
+private:
+    std::thread thread;
+    std::function<void()> step;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool kicked = false;
+    bool running = false;
+};
+
+#endif //MATF_RG_GAME_OMEGA_FRAMEPIPELINE_HPP
@@ -0,0 +1,40 @@
+#ifndef MATF_RG_GAME_OMEGA_FRUSTUM_HPP
+#define MATF_RG_GAME_OMEGA_FRUSTUM_HPP
+
+#include <glm/glm.hpp>
+
+// Clip planes of a view projection matrix, used to skip objects whose bounding sphere is
+// completely outside of it. Works for perspective and orthographic (light space) matrices.
+class Frustum {
+public:
+    // the near plane can be left out for shadow passes, where depth clamping keeps casters behind the light
+    explicit Frustum(const glm::mat4& viewProjection, bool nearPlane = true){
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 - row2;
+        planes[5] = row3 + row2;
+        planeCount = nearPlane ? 6 : 5;
+        for(unsigned int i = 0; i < 6; ++i)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    bool sphereVisible(const glm::vec3& center, float radius) const {
+        for(unsigned int i = 0; i < planeCount; ++i)
+            if(glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+                return false;
+        return true;
+    }
+
+private:
+    // far plane at index 4 and near plane last so it can be skipped
+    glm::vec4 planes[6];
+    unsigned int planeCount;
+};
+
+#endif //MATF_RG_GAME_OMEGA_FRUSTUM_HPP
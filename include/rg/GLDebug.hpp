@@ -0,0 +1,135 @@
+#ifndef MATF_RG_GAME_OMEGA_GLDEBUG_HPP
+#define MATF_RG_GAME_OMEGA_GLDEBUG_HPP
+
+#include <glad/glad.h>
+
+// on unless NDEBUG is defined, -DRG_GL_DEBUG=1 keeps it in release builds with asynchronous output
+#ifndef RG_GL_DEBUG
+#ifdef NDEBUG
+#define RG_GL_DEBUG 0
+#else
+#define RG_GL_DEBUG 1
+#endif
+#endif
+
+#if RG_GL_DEBUG
+
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+
+// KHR_debug is not in the loaded 3.3 core profile, its enums and entry points are declared here
+#define RG_GL_DEBUG_OUTPUT 0x92E0
+#define RG_GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define RG_GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define RG_GL_DEBUG_TYPE_ERROR 0x824C
+#define RG_GL_DEBUG_SEVERITY_HIGH 0x9146
+#define RG_GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define RG_GL_DEBUG_SEVERITY_LOW 0x9148
+#define RG_GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define RG_GL_BUFFER 0x82E0
+#define RG_GL_PROGRAM 0x82E2
+#define RG_GL_VERTEX_ARRAY 0x8074
+
+// Driver diagnostics through KHR_debug. Errors and warnings arrive at a callback as they happen
+// instead of being polled with glGetError, which stalls on the driver. Passes show up as debug
+// groups and objects by their labels in the messages and in frame debuggers like RenderDoc.
+// Debug builds get the messages synchronously, so a breakpoint in the callback stops on the
+// offending call, release builds that keep the layer let the driver report them later.
+class GLDebug {
+public:
+    typedef void (APIENTRY *DebugMessageCallbackProc)(GLDEBUGPROC callback, const void* userParam);
+    typedef void (APIENTRY *DebugMessageControlProc)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint* ids, GLboolean enabled);
+    typedef void (APIENTRY *PushDebugGroupProc)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+    typedef void (APIENTRY *PopDebugGroupProc)();
+    typedef void (APIENTRY *ObjectLabelProc)(GLenum identifier, GLuint name, GLsizei length, const GLchar* label);
+
+    // false when the context has no KHR_debug, the groups and labels then do nothing
+    static bool install(){
+        GLDebug& debug = instance();
+        if(!glfwExtensionSupported("GL_KHR_debug")){
+            std::cerr << "ERROR::GL_DEBUG GL_KHR_debug is not supported" << std::endl;
+            return false;
+        }
+        DebugMessageCallbackProc callback = (DebugMessageCallbackProc)glfwGetProcAddress("glDebugMessageCallback");
+        DebugMessageControlProc control = (DebugMessageControlProc)glfwGetProcAddress("glDebugMessageControl");
+        debug.pushGroup = (PushDebugGroupProc)glfwGetProcAddress("glPushDebugGroup");
+        debug.popGroup = (PopDebugGroupProc)glfwGetProcAddress("glPopDebugGroup");
+        debug.objectLabel = (ObjectLabelProc)glfwGetProcAddress("glObjectLabel");
+        if(!callback || !control || !debug.pushGroup || !debug.popGroup || !debug.objectLabel){
+            debug.pushGroup = nullptr;
+            debug.popGroup = nullptr;
+            debug.objectLabel = nullptr;
+            return false;
+        }
+        glEnable(RG_GL_DEBUG_OUTPUT);
+#ifdef NDEBUG
+        glDisable(RG_GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#else
+        glEnable(RG_GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+        // notifications are mostly the driver describing buffer placement, and our own groups
+        control(GL_DONT_CARE, GL_DONT_CARE, RG_GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+        callback(message, nullptr);
+        debug.enabled = true;
+        return true;
+    }
+
+    static bool active(){
+        return instance().enabled;
+    }
+
+    static void begin(const char* name){
+        GLDebug& debug = instance();
+        if(debug.enabled)
+            debug.pushGroup(RG_GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+    }
+
+    static void end(){
+        GLDebug& debug = instance();
+        if(debug.enabled)
+            debug.popGroup();
+    }
+
+    static void label(GLenum identifier, GLuint object, const char* name){
+        GLDebug& debug = instance();
+        if(debug.enabled)
+            debug.objectLabel(identifier, object, -1, name);
+    }
+
+private:
+    bool enabled = false;
+    PushDebugGroupProc pushGroup = nullptr;
+    PopDebugGroupProc popGroup = nullptr;
+    ObjectLabelProc objectLabel = nullptr;
+
+    static GLDebug& instance(){
+        static GLDebug debug;
+        return debug;
+    }
+
+    // asynchronous output calls this from a driver thread, it only ever writes to std::cerr
+    static void APIENTRY message(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* text, const void* userParam){
+        const char* level = severity == RG_GL_DEBUG_SEVERITY_HIGH ? "high" : severity == RG_GL_DEBUG_SEVERITY_MEDIUM ? "medium" : "low";
+        std::cerr << (type == RG_GL_DEBUG_TYPE_ERROR ? "ERROR::GL " : "WARNING::GL ") << level << " " << id << ": " << text << std::endl;
+    }
+};
+
+#define GL_DEBUG_INSTALL() GLDebug::install()
+#define GL_DEBUG_BEGIN(name) GLDebug::begin(name)
+#define GL_DEBUG_END() GLDebug::end()
+#define GL_DEBUG_LABEL(identifier, object, name) GLDebug::label(identifier, object, name)
+#define GL_DEBUG_ACTIVE() GLDebug::active()
+
+#else
+
+// compiled out, the arguments are not evaluated
+#define GL_DEBUG_INSTALL() do {} while(0)
+#define GL_DEBUG_BEGIN(name) do {} while(0)
+#define GL_DEBUG_END() do {} while(0)
+#define GL_DEBUG_LABEL(identifier, object, name) do {} while(0)
+#define GL_DEBUG_ACTIVE() false
+
+#endif
+
+#endif //MATF_RG_GAME_OMEGA_GLDEBUG_HPP
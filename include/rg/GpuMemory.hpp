@@ -0,0 +1,169 @@
+#ifndef MATF_RG_GAME_OMEGA_GPUMEMORY_HPP
+#define MATF_RG_GAME_OMEGA_GPUMEMORY_HPP
+
+#include <glad/glad.h>
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define GPU_MEMORY_MB (1024.0 * 1024.0)
+
+enum GpuCategory {
+    // framebuffer attachments, they grow with the resolution and the sample count
+    GPU_RENDER_TARGETS,
+    GPU_TEXTURES,
+    GPU_GEOMETRY,
+    // buffers refilled every frame
+    GPU_STREAMING,
+    GPU_CATEGORY_COUNT
+};
+
+enum GpuObject {
+    GPU_TEXTURE,
+    GPU_RENDERBUFFER,
+    GPU_BUFFER
+};
+
+// Video memory the renderer has allocated, by category. GL doesn't report what an allocation
+// really takes, sizes are computed from the formats and dimensions, drivers may pad them. Every
+// texture, renderbuffer and buffer storage call is followed by a record of it under the object's
+// name, allocating an object again replaces its record, deleting it should release it.
+// Main thread only, like the GL calls themselves.
+class GpuMemory {
+public:
+    static GpuMemory& tracker(){
+        static GpuMemory memory;
+        return memory;
+    }
+
+    static const char* categoryName(unsigned int category){
+        static const char* names[GPU_CATEGORY_COUNT] = {"Render targets", "Textures", "Geometry", "Streaming"};
+        return names[category];
+    }
+
+    // bytes a texel takes, unsized formats are counted the way drivers usually store them
+    static unsigned int texelSize(GLenum internalFormat){
+        switch(internalFormat){
+            case GL_RED: case GL_R8: return 1;
+            case GL_RG: case GL_RG8: return 2;
+            case GL_RGBA16F: case GL_RGB16F: case GL_RG32F: case GL_RG32UI: return 8;
+            case GL_RGBA32F: case GL_RGB32F: return 16;
+            // RGB, sRGB, RGB10_A2, R11F_G11F_B10F, 32 bit floats and the depth formats
+            default: return 4;
+        }
+    }
+
+    // a full mip chain adds the smaller levels down to 1x1
+    static uint64_t textureBytes(GLenum internalFormat, int width, int height, int layers = 1, int samples = 1, bool mipmapped = false){
+        uint64_t bytes = 0;
+        while(true){
+            bytes += (uint64_t)width * height * layers * std::max(samples, 1) * texelSize(internalFormat);
+            if(!mipmapped || (width <= 1 && height <= 1))
+                return bytes;
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+    }
+
+    void texture(GpuCategory category, GLuint id, const char* name, GLenum internalFormat, int width, int height,
+                 int layers = 1, int samples = 1, bool mipmapped = false){
+        record(GPU_TEXTURE, id, category, name, textureBytes(internalFormat, width, height, layers, samples, mipmapped));
+    }
+
+    void renderbuffer(GLuint id, const char* name, GLenum internalFormat, int width, int height, int samples = 1){
+        record(GPU_RENDERBUFFER, id, GPU_RENDER_TARGETS, name, textureBytes(internalFormat, width, height, 1, samples));
+    }
+
+    void buffer(GpuCategory category, GLuint id, const char* name, uint64_t bytes){
+        record(GPU_BUFFER, id, category, name, bytes);
+    }
+
+    void release(GpuObject kind, GLuint id){
+        std::unordered_map<uint64_t, Allocation>::iterator found = allocations.find(key(kind, id));
+        if(found == allocations.end())
+            return;
+        totals[found->second.category] -= found->second.bytes;
+        allocations.erase(found);
+        checkBudget();
+    }
+
+    void setBudget(uint64_t bytes){
+        budget = bytes;
+        checkBudget();
+    }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for(unsigned int i = 0; i < GPU_CATEGORY_COUNT; ++i)
+            sum += totals[i];
+        return sum;
+    }
+
+    uint64_t total(GpuCategory category) const {
+        return totals[category];
+    }
+
+    // in the window that is being built
+    void drawImGui(){
+        ImGui::Text("Total %.1f MB of %.0f MB budget", total() / GPU_MEMORY_MB, budget / GPU_MEMORY_MB);
+        if(overBudget)
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Over budget by %.1f MB", (total() - budget) / GPU_MEMORY_MB);
+        for(unsigned int i = 0; i < GPU_CATEGORY_COUNT; ++i)
+            ImGui::Text("%s: %.1f MB", categoryName(i), totals[i] / GPU_MEMORY_MB);
+        if(ImGui::CollapsingHeader("Allocations")){
+            std::vector<const Allocation*> sorted;
+            for(const std::pair<const uint64_t, Allocation>& entry : allocations)
+                sorted.push_back(&entry.second);
+            std::sort(sorted.begin(), sorted.end(), [](const Allocation* a, const Allocation* b){ return a->bytes > b->bytes; });
+            for(const Allocation* allocation : sorted)
+                ImGui::Text("%8.2f MB  %s", allocation->bytes / GPU_MEMORY_MB, allocation->name.c_str());
+        }
+    }
+
+private:
+    struct Allocation {
+        GpuCategory category;
+        uint64_t bytes;
+        std::string name;
+    };
+
+    std::unordered_map<uint64_t, Allocation> allocations;
+    uint64_t totals[GPU_CATEGORY_COUNT] = {};
+    // 0 until a budget is set
+    uint64_t budget = 0;
+    bool overBudget = false;
+
+    static uint64_t key(GpuObject kind, GLuint id){
+        return ((uint64_t)kind << 32) | id;
+    }
+
+    void record(GpuObject kind, GLuint id, GpuCategory category, const char* name, uint64_t bytes){
+        std::unordered_map<uint64_t, Allocation>::iterator found = allocations.find(key(kind, id));
+        if(found != allocations.end())
+            totals[found->second.category] -= found->second.bytes;
+        else
+            found = allocations.insert(std::make_pair(key(kind, id), Allocation())).first;
+        Allocation& allocation = found->second;
+        allocation.category = category;
+        allocation.bytes = bytes;
+        allocation.name = name;
+        totals[category] += bytes;
+        checkBudget();
+    }
+
+    // warns once on the way over, again only after it got back under
+    void checkBudget(){
+        bool over = budget > 0 && total() > budget;
+        if(over && !overBudget)
+            std::cerr << "WARNING::GPU_MEMORY " << total() / GPU_MEMORY_MB << " MB allocated, the budget is "
+                      << budget / GPU_MEMORY_MB << " MB" << std::endl;
+        overBudget = over;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_GPUMEMORY_HPP
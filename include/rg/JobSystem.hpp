@@ -0,0 +1,251 @@
+#ifndef MATF_RG_GAME_OMEGA_JOBSYSTEM_HPP
+#define MATF_RG_GAME_OMEGA_JOBSYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rg/Trace.hpp"
+
+struct Job {
+    std::function<void()> work;
+    // unfinished dependencies, plus one held while the job is being submitted
+    std::atomic<int> pending{1};
+    std::atomic<bool> finished{false};
+    bool mainThread = false;
+
+    std::mutex mutex;
+    // jobs waiting for this one, guarded by the mutex together with finished
+    std::vector<std::shared_ptr<Job>> dependents;
+};
+
+// Work-stealing scheduler. Every worker pops its own deque from the back and steals from the
+// front of the others, threads outside of the pool submit to a shared queue. Waiting never
+// blocks, the waiting thread runs other jobs until the one it waits for is done. Jobs marked
+// for the main thread only run from runMainThreadJobs() or a wait on the main thread, that's
+// where GL work goes.
+class JobSystem {
+public:
+    typedef std::shared_ptr<Job> Handle;
+
+    // 0 uses one worker less than there are hardware threads, the main thread makes up for it
+    explicit JobSystem(unsigned int threads = 0) : mainThreadId(std::this_thread::get_id()) {
+        if(threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        queues.resize(threads);
+        for(unsigned int i = 0; i < threads; ++i)
+            queues[i].reset(new Queue());
+        for(unsigned int i = 0; i < threads; ++i)
+            workers.emplace_back([this, i](){ workerLoop(i); });
+    }
+
+    ~JobSystem(){
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+
+    // the job starts once all dependencies have finished
+    Handle submit(std::function<void()> work, std::initializer_list<Handle> dependencies = {}){
+        return add(std::move(work), dependencies, false);
+    }
+
+    Handle submitMain(std::function<void()> work, std::initializer_list<Handle> dependencies = {}){
+        return add(std::move(work), dependencies, true);
+    }
+
+    void wait(const Handle& job){
+        while(!job->finished.load(std::memory_order_acquire)){
+            Handle next = take();
+            if(next)
+                execute(next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // calls fn(first, last) on chunks of at most grain indices, returns when all of them are done
+    template<typename Fn>
+    void parallelFor(unsigned int begin, unsigned int end, unsigned int grain, Fn fn){
+        grain = std::max(grain, 1u);
+        if(end - begin <= grain){
+            if(begin < end)
+                fn(begin, end);
+            return;
+        }
+        std::vector<Handle> chunks;
+        chunks.reserve((end - begin) / grain);
+        // the first chunk runs on the calling thread
+        for(unsigned int first = begin + grain; first < end; first += grain){
+            unsigned int last = std::min(first + grain, end);
+            chunks.push_back(submit([fn, first, last](){ fn(first, last); }));
+        }
+        fn(begin, begin + grain);
+        for(const Handle& chunk : chunks)
+            wait(chunk);
+    }
+
+    // runs the GL jobs that are ready, called once per frame by the main thread
+    void runMainThreadJobs(){
+        Handle job;
+        while((job = popMain()))
+            execute(job);
+    }
+
+    unsigned int workerCount() const {
+        return workers.size();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Handle> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    Queue shared;
+    Queue mainQueue;
+    std::vector<std::thread> workers;
+    std::thread::id mainThreadId;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<unsigned int> queued{0};
+    bool stopping = false;
+
+    static int& workerIndex(){
+        static thread_local int index = -1;
+        return index;
+    }
+
+    Handle add(std::function<void()> work, std::initializer_list<Handle> dependencies, bool mainThread){
+        Handle job = std::make_shared<Job>();
+        job->work = std::move(work);
+        job->mainThread = mainThread;
+        for(const Handle& dependency : dependencies){
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if(!dependency->finished.load(std::memory_order_relaxed)){
+                job->pending.fetch_add(1, std::memory_order_relaxed);
+                dependency->dependents.push_back(job);
+            }
+        }
+        release(job);
+        return job;
+    }
+
+    // drops one pending count and schedules the job once nothing holds it back
+    void release(const Handle& job){
+        if(job->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        if(job->mainThread){
+            std::lock_guard<std::mutex> lock(mainQueue.mutex);
+            mainQueue.jobs.push_back(job);
+            return;
+        }
+        int index = workerIndex();
+        Queue& queue = index >= 0 ? *queues[index] : shared;
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(job);
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake.notify_one();
+    }
+
+    void execute(const Handle& job){
+        job->work();
+        std::vector<Handle> dependents;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->finished.store(true, std::memory_order_release);
+            dependents.swap(job->dependents);
+        }
+        for(const Handle& dependent : dependents)
+            release(dependent);
+    }
+
+    Handle popMain(){
+        std::lock_guard<std::mutex> lock(mainQueue.mutex);
+        if(mainQueue.jobs.empty())
+            return Handle();
+        Handle job = mainQueue.jobs.front();
+        mainQueue.jobs.pop_front();
+        return job;
+    }
+
+    // own deque newest first, then the shared queue, then the oldest job of another worker
+    Handle take(){
+        if(std::this_thread::get_id() == mainThreadId){
+            Handle job = popMain();
+            if(job)
+                return job;
+        }
+        int index = workerIndex();
+        if(index >= 0){
+            Queue& own = *queues[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.jobs.empty()){
+                Handle job = own.jobs.back();
+                own.jobs.pop_back();
+                return claimed(job);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if(!shared.jobs.empty()){
+                Handle job = shared.jobs.front();
+                shared.jobs.pop_front();
+                return claimed(job);
+            }
+        }
+        unsigned int count = queues.size();
+        unsigned int start = index >= 0 ? index + 1 : 0;
+        for(unsigned int i = 0; i < count; ++i){
+            Queue& victim = *queues[(start + i) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.jobs.empty()){
+                Handle job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return claimed(job);
+            }
+        }
+        return Handle();
+    }
+
+    Handle claimed(const Handle& job){
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    void workerLoop(int index){
+        workerIndex() = index;
+        Trace::setThreadName("Job worker");
+        while(true){
+            Handle job = take();
+            if(job){
+                execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this](){ return stopping || queued.load(std::memory_order_relaxed) > 0; });
+            if(stopping)
+                return;
+        }
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_JOBSYSTEM_HPP
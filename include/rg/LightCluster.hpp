@@ -0,0 +1,304 @@
+#ifndef MATF_RG_GAME_OMEGA_LIGHTCLUSTER_HPP
+#define MATF_RG_GAME_OMEGA_LIGHTCLUSTER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include "rg/GLDebug.hpp"
+#include "rg/GpuMemory.hpp"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// froxel grid dimensions - tiles across the screen and exponential depth slices
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+// a light takes this many RGBA32F texels in the light buffer
+#define CLUSTER_LIGHT_TEXELS 5
+#define CLUSTER_MAX_LIGHTS 1024
+// first texture unit used by the cluster buffers, the next two are used as well
+#define CLUSTER_TEXTURE_UNIT 4
+// dimmer diffuse colors are taken as this bright when sizing a light
+#define CLUSTER_MIN_BRIGHTNESS 1e-4f
+
+struct ClusteredLight {
+    glm::vec3 position;
+    // only used by spot lights
+    glm::vec3 direction;
+
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float cutOff;
+    float outerCutOff;
+
+    bool spot;
+};
+
+// Keeps many point and spot lights in texture buffers and bins them into a view space
+// froxel grid every frame, so a fragment only loops over the lights touching its cluster.
+class LightCluster {
+public:
+    LightCluster(){
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for(unsigned int i = 0; i < 3; ++i){
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        for(unsigned int i = 0; i < 3; ++i){
+            GL_DEBUG_LABEL(RG_GL_BUFFER, buffers[i], bufferName(i));
+            GpuMemory::tracker().buffer(GPU_STREAMING, buffers[i], bufferName(i), 16);
+        }
+
+        lights.reserve(CLUSTER_MAX_LIGHTS);
+        grid.resize(2 * CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+        counts.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+        maxLightsPerCluster = 0;
+    }
+
+    ~LightCluster(){
+        for(unsigned int i = 0; i < 3; ++i)
+            GpuMemory::tracker().release(GPU_BUFFER, buffers[i]);
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    void clear(){
+        lights.clear();
+    }
+
+    bool addLight(const ClusteredLight& light){
+        if(lights.size() >= CLUSTER_MAX_LIGHTS)
+            return false;
+        lights.push_back(light);
+        return true;
+    }
+
+    // bins all lights into the grid of the given symmetric perspective and uploads the result
+    void update(const glm::mat4& view, float fovY, float aspect, float zNear, float zFar,
+                unsigned int screenWidth, unsigned int screenHeight){
+        this->screenWidth = (float)screenWidth;
+        this->screenHeight = (float)screenHeight;
+        float logRatio = std::log(zFar / zNear);
+        zScale = CLUSTER_Z / logRatio;
+        zBias = CLUSTER_Z * std::log(zNear) / logRatio;
+
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+
+        ranges.resize(lights.size());
+        std::fill(counts.begin(), counts.end(), 0);
+        for(unsigned int i = 0; i < lights.size(); ++i){
+            ranges[i] = lightRange(view, lights[i], tanX, tanY, zNear, zFar);
+            forEachCluster(ranges[i], [this](unsigned int cluster){ counts[cluster]++; });
+        }
+
+        unsigned int offset = 0;
+        maxLightsPerCluster = 0;
+        for(unsigned int cluster = 0; cluster < counts.size(); ++cluster){
+            grid[2 * cluster] = offset;
+            grid[2 * cluster + 1] = 0;
+            offset += counts[cluster];
+            maxLightsPerCluster = std::max(maxLightsPerCluster, counts[cluster]);
+        }
+
+        indices.resize(offset);
+        for(unsigned int i = 0; i < lights.size(); ++i){
+            forEachCluster(ranges[i], [this, i](unsigned int cluster){
+                indices[grid[2 * cluster] + grid[2 * cluster + 1]++] = i;
+            });
+        }
+
+        packLights();
+        upload(0, packed.data(), packed.size() * sizeof(float));
+        upload(1, grid.data(), grid.size() * sizeof(GLuint));
+        upload(2, indices.data(), indices.size() * sizeof(GLuint));
+    }
+
+    // binds the cluster buffers and sets the uniforms the lighting shaders read them with
+    void bind(const Shader& shader, bool enabled){
+        for(unsigned int i = 0; i < 3; ++i){
+            glActiveTexture(GL_TEXTURE0 + CLUSTER_TEXTURE_UNIT + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setBool("clusteredLighting", enabled);
+        shader.setInt("clusterLights", CLUSTER_TEXTURE_UNIT);
+        shader.setInt("clusterGrid", CLUSTER_TEXTURE_UNIT + 1);
+        shader.setInt("clusterIndices", CLUSTER_TEXTURE_UNIT + 2);
+        glUniform3i(glGetUniformLocation(shader.ID, "clusterDims"), CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+        shader.setVec2("clusterScreenSize", screenWidth, screenHeight);
+        shader.setFloat("clusterZScale", zScale);
+        shader.setFloat("clusterZBias", zBias);
+    }
+
+    unsigned int lightCount() const {
+        return lights.size();
+    }
+
+    unsigned int indexCount() const {
+        return indices.size();
+    }
+
+    unsigned int maxPerCluster() const {
+        return maxLightsPerCluster;
+    }
+
+    // distance at which the attenuation drops the light below 5/256 of its brightest channel,
+    // 0 for a light that is below it everywhere
+    static float lightRadius(const ClusteredLight& light){
+        float brightest = std::max(std::max(std::max(light.diffuse.r, light.diffuse.g), light.diffuse.b), CLUSTER_MIN_BRIGHTNESS);
+        float c = light.constant - brightest * (256.0f / 5.0f);
+        if(c >= 0.0f)
+            return 0.0f;
+        if(light.quadratic <= 0.0f)
+            return light.linear > 0.0f ? -c / light.linear : 1000.0f;
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c))
+               / (2.0f * light.quadratic);
+    }
+
+    // normalized device xy extent and view distance range of a sphere
+    struct SphereBounds {
+        float minX, maxX;
+        float minY, maxY;
+        float nearest, farthest;
+    };
+
+    // conservative screen bounds of a sphere under a symmetric perspective, false if it is not visible
+    static bool sphereBounds(const glm::mat4& view, const glm::vec3& position, float radius,
+                             float tanX, float tanY, float zNear, float zFar, SphereBounds& bounds){
+        glm::vec4 center = view * glm::vec4(position, 1.0f);
+
+        // view space looks down -z, work with positive distances
+        bounds.nearest = -center.z - radius;
+        bounds.farthest = -center.z + radius;
+        if(bounds.farthest < zNear || bounds.nearest > zFar)
+            return false;
+
+        if(bounds.nearest <= zNear){
+            // the sphere crosses the near plane so it can cover any part of the screen
+            bounds.minX = bounds.minY = -1.0f;
+            bounds.maxX = bounds.maxY = 1.0f;
+            return true;
+        }
+
+        float minX = center.x - radius, maxX = center.x + radius;
+        float minY = center.y - radius, maxY = center.y + radius;
+        bounds.minX = std::min(minX / bounds.nearest, minX / bounds.farthest) / tanX;
+        bounds.maxX = std::max(maxX / bounds.nearest, maxX / bounds.farthest) / tanX;
+        bounds.minY = std::min(minY / bounds.nearest, minY / bounds.farthest) / tanY;
+        bounds.maxY = std::max(maxY / bounds.nearest, maxY / bounds.farthest) / tanY;
+        return !(bounds.maxX < -1.0f || bounds.minX > 1.0f || bounds.maxY < -1.0f || bounds.minY > 1.0f);
+    }
+
+    const std::vector<ClusteredLight>& getLights() const {
+        return lights;
+    }
+
+private:
+
+    struct ClusterRange {
+        int x0, x1;
+        int y0, y1;
+        int z0, z1;
+    };
+
+    unsigned int buffers[3];
+    unsigned int textures[3];
+
+    std::vector<ClusteredLight> lights;
+    std::vector<ClusterRange> ranges;
+    std::vector<float> packed;
+    std::vector<GLuint> grid;
+    std::vector<GLuint> counts;
+    std::vector<GLuint> indices;
+    GLuint maxLightsPerCluster;
+
+    float screenWidth = 1.0f;
+    float screenHeight = 1.0f;
+    float zScale = 1.0f;
+    float zBias = 0.0f;
+
+    int sliceOf(float depth) const {
+        if(depth <= 0.0f)
+            return 0;
+        int slice = (int)std::floor(std::log(depth) * zScale - zBias);
+        return std::min(std::max(slice, 0), CLUSTER_Z - 1);
+    }
+
+    static int tileOf(float ndc, int tiles){
+        int tile = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return std::min(std::max(tile, 0), tiles - 1);
+    }
+
+    // conservative range of clusters touched by the light's bounding sphere, empty if it is off screen
+    ClusterRange lightRange(const glm::mat4& view, const ClusteredLight& light,
+                            float tanX, float tanY, float zNear, float zFar) const {
+        ClusterRange range = {0, -1, 0, -1, 0, -1};
+        SphereBounds bounds;
+        if(!sphereBounds(view, light.position, lightRadius(light), tanX, tanY, zNear, zFar, bounds))
+            return range;
+
+        range.z0 = sliceOf(bounds.nearest);
+        range.z1 = sliceOf(bounds.farthest);
+        range.x0 = tileOf(bounds.minX, CLUSTER_X);
+        range.x1 = tileOf(bounds.maxX, CLUSTER_X);
+        range.y0 = tileOf(bounds.minY, CLUSTER_Y);
+        range.y1 = tileOf(bounds.maxY, CLUSTER_Y);
+        return range;
+    }
+
+    template<typename Fn>
+    static void forEachCluster(const ClusterRange& range, Fn fn){
+        for(int z = range.z0; z <= range.z1; ++z)
+            for(int y = range.y0; y <= range.y1; ++y)
+                for(int x = range.x0; x <= range.x1; ++x)
+                    fn(x + CLUSTER_X * (y + CLUSTER_Y * z));
+    }
+
+    void packLights(){
+        packed.resize(lights.size() * CLUSTER_LIGHT_TEXELS * 4);
+        float* out = packed.data();
+        for(const ClusteredLight& light : lights){
+            const float texels[CLUSTER_LIGHT_TEXELS * 4] = {
+                    light.position.x, light.position.y, light.position.z, lightRadius(light),
+                    light.diffuse.r, light.diffuse.g, light.diffuse.b, light.spot ? 1.0f : 0.0f,
+                    light.specular.r, light.specular.g, light.specular.b, light.constant,
+                    light.direction.x, light.direction.y, light.direction.z, light.cutOff,
+                    light.linear, light.quadratic, light.outerCutOff, 0.0f
+            };
+            std::copy(texels, texels + CLUSTER_LIGHT_TEXELS * 4, out);
+            out += CLUSTER_LIGHT_TEXELS * 4;
+        }
+    }
+
+    static const char* bufferName(unsigned int buffer){
+        static const char* names[3] = {"Cluster lights", "Cluster grid", "Cluster light indices"};
+        return names[buffer];
+    }
+
+    void upload(unsigned int buffer, const void* data, size_t size){
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        // orphan the previous storage so the driver doesn't wait on frames still reading it
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), nullptr, GL_STREAM_DRAW);
+        GpuMemory::tracker().buffer(GPU_STREAMING, buffers[buffer], bufferName(buffer), std::max(size, (size_t)16));
+        if(size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_LIGHTCLUSTER_HPP
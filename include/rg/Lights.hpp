@@ -0,0 +1,43 @@
+#ifndef MATF_RG_GAME_OMEGA_LIGHTS_HPP
+#define MATF_RG_GAME_OMEGA_LIGHTS_HPP
+
+#include <glm/glm.hpp>
+
+struct SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float cutOff;
+    float outerCutOff;
+};
+
+struct PointLight {
+    glm::vec3 position;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+//global light
+struct DirLight {
+    glm::vec3 direction;
+
+    glm::vec3 ambient;
+    glm::vec3 specular;
+    glm::vec3 diffuse;
+};
+
+#endif //MATF_RG_GAME_OMEGA_LIGHTS_HPP
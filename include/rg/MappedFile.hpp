@@ -0,0 +1,70 @@
+#ifndef MATF_RG_GAME_OMEGA_MAPPEDFILE_HPP
+#define MATF_RG_GAME_OMEGA_MAPPEDFILE_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// Read only memory mapping of a whole file, unmapped when it goes out of scope
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path){
+        open(path);
+    }
+
+    ~MappedFile(){
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path){
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat info;
+        if(fstat(fd, &info) == 0 && info.st_size > 0){
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped != MAP_FAILED){
+                bytes = static_cast<const char*>(mapped);
+                length = info.st_size;
+                // the whole file is about to be read front to back
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            } else {
+                std::cerr << "ERROR::MAPPED_FILE could not map " << path << std::endl;
+            }
+        }
+        ::close(fd);
+        return bytes != nullptr;
+    }
+
+    void close(){
+        if(bytes)
+            munmap(const_cast<char*>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+};
+
+#endif //MATF_RG_GAME_OMEGA_MAPPEDFILE_HPP
@@ -0,0 +1,529 @@
+#ifndef MATF_RG_GAME_OMEGA_OBJLOADER_HPP
+#define MATF_RG_GAME_OMEGA_OBJLOADER_HPP
+
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+
+#include "rg/JobSystem.hpp"
+#include "rg/Trace.hpp"
+#include "rg/AssetPack.hpp"
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// files are split into about this many bytes per parse job
+#define OBJ_CHUNK_BYTES (256 * 1024)
+#define OBJ_FACES_PER_JOB 4096
+
+struct ObjMaterial {
+    std::string diffuse;
+    std::string specular;
+    std::string bump;
+    std::string ambient;
+};
+
+// Wavefront OBJ/MTL loader that parses line aligned chunks of a memory mapped file or asset pack entry in parallel.
+// The output matches what Model gets from Assimp with Triangulate | FlipUVs: one vertex per
+// face corner, polygons split into fans and one mesh per material in order of first use.
+class ObjLoader {
+public:
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::string material;
+    };
+
+    std::vector<MeshData> meshes;
+    std::map<std::string, ObjMaterial> materials;
+
+    bool load(const std::string& path, JobSystem& jobs){
+        AssetFile file;
+        if(!file.open(path)){
+            std::cerr << "ERROR::OBJ could not read " << path << std::endl;
+            return false;
+        }
+        parseChunks(file.data(), file.data() + file.size(), jobs);
+        {
+            TraceScope scope("OBJ merge");
+            if(!merge(jobs))
+                return false;
+        }
+        {
+            TraceScope scope("OBJ meshes");
+            buildMeshes(jobs);
+        }
+
+        TraceScope scope("MTL");
+        std::string directory = path.substr(0, path.find_last_of('/'));
+        for(const std::string& library : libraries)
+            loadMaterials(directory + '/' + library);
+        return true;
+    }
+
+    // parses a float without locale lookups or allocations, p is left after the number
+    static float parseFloat(const char*& p, const char* end){
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        skipBlanks(p, end);
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        unsigned int digits = 0;
+        for(; p < end && isDigit(*p); ++p){
+            if(digits++ < 19)
+                mantissa = mantissa * 10 + (*p - '0');
+            else
+                exponent++;
+        }
+        if(p < end && *p == '.'){
+            for(++p; p < end && isDigit(*p); ++p){
+                if(digits++ < 19){
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                }
+            }
+        }
+        if(p < end && (*p == 'e' || *p == 'E')){
+            ++p;
+            bool negativeExponent = false;
+            if(p < end && (*p == '-' || *p == '+'))
+                negativeExponent = *p++ == '-';
+            int value = 0;
+            for(; p < end && isDigit(*p); ++p)
+                value = std::min(value * 10 + (*p - '0'), 10000);
+            exponent += negativeExponent ? -value : value;
+        }
+        double result = (double)mantissa;
+        if(exponent < 0)
+            result = -exponent <= 22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+        else if(exponent > 0)
+            result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+        return (float)(negative ? -result : result);
+    }
+
+private:
+    // an index is either 0 based into the whole file or, for negative OBJ indices, relative to the
+    // start of its chunk until the chunks are merged
+    struct Corner {
+        int position;
+        int texCoord;
+        int normal;
+        uint8_t relative;
+    };
+
+    struct Face {
+        unsigned int firstCorner;
+        unsigned int cornerCount;
+    };
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners;
+        std::vector<Face> faces;
+        // face index in the chunk the material starts at
+        std::vector<std::pair<unsigned int, std::string>> materialSwitches;
+        std::vector<std::string> libraries;
+    };
+
+    static const int MISSING = INT_MIN;
+    static const uint8_t RELATIVE_POSITION = 1;
+    static const uint8_t RELATIVE_TEXCOORD = 2;
+    static const uint8_t RELATIVE_NORMAL = 4;
+
+    std::vector<Chunk> chunks;
+    std::vector<std::string> libraries;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<Corner> corners;
+    std::vector<Face> faces;
+    std::vector<unsigned int> faceMaterial;
+
+    static bool isDigit(char c){
+        return c >= '0' && c <= '9';
+    }
+
+    static bool isBlank(char c){
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static void skipBlanks(const char*& p, const char* end){
+        while(p < end && isBlank(*p))
+            ++p;
+    }
+
+    static void skipLine(const char*& p, const char* end){
+        while(p < end && *p != '\n')
+            ++p;
+        if(p < end)
+            ++p;
+    }
+
+    // moves p past the keyword if the line starts with it
+    static bool keyword(const char*& p, const char* end, const char* word){
+        size_t length = std::strlen(word);
+        if((size_t)(end - p) <= length || std::strncmp(p, word, length) != 0 || !isBlank(p[length]))
+            return false;
+        p += length;
+        return true;
+    }
+
+    static std::string restOfLine(const char*& p, const char* end){
+        skipBlanks(p, end);
+        const char* start = p;
+        while(p < end && *p != '\n')
+            ++p;
+        const char* last = p;
+        while(last > start && isBlank(last[-1]))
+            --last;
+        return std::string(start, last);
+    }
+
+    static int parseInt(const char*& p, const char* end){
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        int value = 0;
+        for(; p < end && isDigit(*p); ++p)
+            value = value * 10 + (*p - '0');
+        return negative ? -value : value;
+    }
+
+    // turns a 1 based OBJ index into the corner encoding, count is what the chunk read so far
+    static int cornerIndex(int index, unsigned int count, uint8_t flag, uint8_t& relative){
+        if(index > 0)
+            return index - 1;
+        if(index < 0){
+            relative |= flag;
+            return (int)count + index;
+        }
+        return MISSING;
+    }
+
+    void parseChunks(const char* begin, const char* end, JobSystem& jobs){
+        // chunk boundaries are moved forward to the next line start
+        const char* start = begin;
+        while(start < end){
+            const char* stop = start + std::min((size_t)(end - start), (size_t)OBJ_CHUNK_BYTES);
+            while(stop < end && stop[-1] != '\n')
+                ++stop;
+            Chunk chunk;
+            chunk.begin = start;
+            chunk.end = stop;
+            chunks.push_back(std::move(chunk));
+            start = stop;
+        }
+        jobs.parallelFor(0, chunks.size(), 1, [this](unsigned int first, unsigned int last){
+            for(unsigned int i = first; i < last; ++i){
+                TraceScope scope("OBJ parse chunk");
+                parseChunk(chunks[i]);
+            }
+        });
+    }
+
+    static void parseChunk(Chunk& chunk){
+        const char* p = chunk.begin;
+        const char* end = chunk.end;
+        while(p < end){
+            skipBlanks(p, end);
+            if(p + 1 >= end){
+                skipLine(p, end);
+                continue;
+            }
+            if(p[0] == 'v' && isBlank(p[1])){
+                p += 1;
+                glm::vec3 position;
+                position.x = parseFloat(p, end);
+                position.y = parseFloat(p, end);
+                position.z = parseFloat(p, end);
+                chunk.positions.push_back(position);
+            } else if(p[0] == 'v' && p[1] == 't'){
+                p += 2;
+                glm::vec2 texCoord;
+                texCoord.x = parseFloat(p, end);
+                texCoord.y = parseFloat(p, end);
+                chunk.texCoords.push_back(texCoord);
+            } else if(p[0] == 'v' && p[1] == 'n'){
+                p += 2;
+                glm::vec3 normal;
+                normal.x = parseFloat(p, end);
+                normal.y = parseFloat(p, end);
+                normal.z = parseFloat(p, end);
+                chunk.normals.push_back(normal);
+            } else if(p[0] == 'f' && isBlank(p[1])){
+                p += 1;
+                Face face;
+                face.firstCorner = chunk.corners.size();
+                while(true){
+                    skipBlanks(p, end);
+                    if(p >= end || !(isDigit(*p) || *p == '-' || *p == '+'))
+                        break;
+                    Corner corner;
+                    corner.relative = 0;
+                    corner.position = cornerIndex(parseInt(p, end), chunk.positions.size(), RELATIVE_POSITION, corner.relative);
+                    corner.texCoord = MISSING;
+                    corner.normal = MISSING;
+                    if(p < end && *p == '/'){
+                        ++p;
+                        if(p < end && *p != '/')
+                            corner.texCoord = cornerIndex(parseInt(p, end), chunk.texCoords.size(), RELATIVE_TEXCOORD, corner.relative);
+                        if(p < end && *p == '/'){
+                            ++p;
+                            corner.normal = cornerIndex(parseInt(p, end), chunk.normals.size(), RELATIVE_NORMAL, corner.relative);
+                        }
+                    }
+                    chunk.corners.push_back(corner);
+                }
+                face.cornerCount = chunk.corners.size() - face.firstCorner;
+                // points and lines are not triangles, Assimp would not put them into the mesh either
+                if(face.cornerCount >= 3)
+                    chunk.faces.push_back(face);
+                else
+                    chunk.corners.resize(face.firstCorner);
+            } else if(keyword(p, end, "usemtl")){
+                chunk.materialSwitches.push_back(std::make_pair((unsigned int)chunk.faces.size(), restOfLine(p, end)));
+            } else if(keyword(p, end, "mtllib")){
+                chunk.libraries.push_back(restOfLine(p, end));
+            }
+            skipLine(p, end);
+        }
+    }
+
+    // concatenates the chunks and resolves relative indices, false if there is nothing to draw
+    bool merge(JobSystem& jobs){
+        // usemtl lines with the global index of the first face they apply to
+        std::vector<std::pair<unsigned int, std::string>> switches;
+        std::vector<unsigned int> positionStart, texCoordStart, normalStart, cornerStart, faceStart;
+        unsigned int positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0, faceCount = 0;
+        for(Chunk& chunk : chunks){
+            positionStart.push_back(positionCount);
+            texCoordStart.push_back(texCoordCount);
+            normalStart.push_back(normalCount);
+            cornerStart.push_back(cornerCount);
+            faceStart.push_back(faceCount);
+            for(const auto& materialSwitch : chunk.materialSwitches)
+                switches.push_back(std::make_pair(faceCount + materialSwitch.first, materialSwitch.second));
+            positionCount += chunk.positions.size();
+            texCoordCount += chunk.texCoords.size();
+            normalCount += chunk.normals.size();
+            cornerCount += chunk.corners.size();
+            faceCount += chunk.faces.size();
+            libraries.insert(libraries.end(), chunk.libraries.begin(), chunk.libraries.end());
+        }
+        if(faceCount == 0 || positionCount == 0)
+            return false;
+
+        positions.resize(positionCount);
+        texCoords.resize(texCoordCount);
+        normals.resize(normalCount);
+        corners.resize(cornerCount);
+        faces.resize(faceCount);
+        faceMaterial.resize(faceCount);
+        jobs.parallelFor(0, chunks.size(), 1, [&](unsigned int first, unsigned int last){
+            for(unsigned int i = first; i < last; ++i){
+                Chunk& chunk = chunks[i];
+                std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionStart[i]);
+                std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + texCoordStart[i]);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalStart[i]);
+                for(unsigned int c = 0; c < chunk.corners.size(); ++c){
+                    Corner corner = chunk.corners[c];
+                    if(corner.relative & RELATIVE_POSITION)
+                        corner.position += positionStart[i];
+                    if(corner.relative & RELATIVE_TEXCOORD)
+                        corner.texCoord += texCoordStart[i];
+                    if(corner.relative & RELATIVE_NORMAL)
+                        corner.normal += normalStart[i];
+                    corners[cornerStart[i] + c] = corner;
+                }
+                for(unsigned int f = 0; f < chunk.faces.size(); ++f){
+                    Face face = chunk.faces[f];
+                    face.firstCorner += cornerStart[i];
+                    faces[faceStart[i] + f] = face;
+                }
+                // the chunk's own geometry is not needed any more
+                chunk = Chunk();
+            }
+        });
+
+        // a material stays active across chunk boundaries, so materials are resolved in file order
+        std::map<std::string, unsigned int> slots;
+        meshes.clear();
+        meshes.push_back(MeshData());
+        slots[""] = 0;
+        for(unsigned int i = 0; i < switches.size(); ++i){
+            unsigned int next = i + 1 < switches.size() ? switches[i + 1].first : faceCount;
+            const std::string& name = switches[i].second;
+            auto slot = slots.find(name);
+            if(slot == slots.end()){
+                slot = slots.insert(std::make_pair(name, (unsigned int)meshes.size())).first;
+                meshes.push_back(MeshData());
+                meshes.back().material = name;
+            }
+            std::fill(faceMaterial.begin() + switches[i].first, faceMaterial.begin() + next, slot->second);
+        }
+        unsigned int firstSwitch = switches.empty() ? faceCount : switches[0].first;
+        std::fill(faceMaterial.begin(), faceMaterial.begin() + firstSwitch, 0u);
+        return true;
+    }
+
+    void buildMeshes(JobSystem& jobs){
+        // where every face writes its vertices and indices inside its material's mesh
+        std::vector<unsigned int> vertexOffset(faces.size()), indexOffset(faces.size());
+        for(unsigned int f = 0; f < faces.size(); ++f){
+            MeshData& mesh = meshes[faceMaterial[f]];
+            vertexOffset[f] = mesh.vertices.size();
+            indexOffset[f] = mesh.indices.size();
+            mesh.vertices.resize(mesh.vertices.size() + faces[f].cornerCount);
+            mesh.indices.resize(mesh.indices.size() + 3 * (faces[f].cornerCount - 2));
+        }
+
+        jobs.parallelFor(0, faces.size(), OBJ_FACES_PER_JOB, [&](unsigned int first, unsigned int last){
+            for(unsigned int f = first; f < last; ++f)
+                buildFace(f, meshes[faceMaterial[f]], vertexOffset[f], indexOffset[f]);
+        });
+
+        // the unnamed mesh only keeps faces before the first usemtl
+        std::vector<MeshData> used;
+        for(MeshData& mesh : meshes)
+            if(!mesh.indices.empty())
+                used.push_back(std::move(mesh));
+        meshes.swap(used);
+    }
+
+    void buildFace(unsigned int f, MeshData& mesh, unsigned int firstVertex, unsigned int firstIndex){
+        const Face& face = faces[f];
+        const Corner* faceCorners = &corners[face.firstCorner];
+
+        glm::vec3 p0 = position(faceCorners[0]), p1 = position(faceCorners[1]), p2 = position(faceCorners[2]);
+        glm::vec2 t0 = texCoord(faceCorners[0]), t1 = texCoord(faceCorners[1]), t2 = texCoord(faceCorners[2]);
+        glm::vec3 edge1 = p1 - p0, edge2 = p2 - p0;
+        glm::vec3 faceNormal = glm::cross(edge1, edge2);
+        float length = glm::length(faceNormal);
+        faceNormal = length > 0.0f ? faceNormal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+
+        // tangent space of the first triangle, shared by the whole face
+        glm::vec2 deltaUV1 = t1 - t0, deltaUV2 = t2 - t0;
+        float determinant = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+        glm::vec3 tangent(0.0f), bitangent(0.0f);
+        if(std::abs(determinant) > 1e-12f){
+            float r = 1.0f / determinant;
+            tangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * r;
+            bitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * r;
+        }
+
+        for(unsigned int c = 0; c < face.cornerCount; ++c){
+            const Corner& corner = faceCorners[c];
+            Vertex& vertex = mesh.vertices[firstVertex + c];
+            vertex.Position = position(corner);
+            vertex.Normal = validIndex(corner.normal, normals.size()) ? normals[corner.normal] : faceNormal;
+            vertex.TexCoords = texCoord(corner);
+            vertex.Tangent = tangent;
+            vertex.Bitangent = bitangent;
+        }
+        for(unsigned int c = 1; c + 1 < face.cornerCount; ++c){
+            unsigned int* index = &mesh.indices[firstIndex + 3 * (c - 1)];
+            index[0] = firstVertex;
+            index[1] = firstVertex + c;
+            index[2] = firstVertex + c + 1;
+        }
+    }
+
+    static bool validIndex(int index, size_t count){
+        return index >= 0 && (size_t)index < count;
+    }
+
+    glm::vec3 position(const Corner& corner) const {
+        return validIndex(corner.position, positions.size()) ? positions[corner.position] : glm::vec3(0.0f);
+    }
+
+    // flipped like aiProcess_FlipUVs does
+    glm::vec2 texCoord(const Corner& corner) const {
+        if(!validIndex(corner.texCoord, texCoords.size()))
+            return glm::vec2(0.0f);
+        return glm::vec2(texCoords[corner.texCoord].x, 1.0f - texCoords[corner.texCoord].y);
+    }
+
+    void loadMaterials(const std::string& path){
+        AssetFile file;
+        if(!file.open(path)){
+            std::cerr << "ERROR::OBJ could not read material library " << path << std::endl;
+            return;
+        }
+        const char* p = file.data();
+        const char* end = p + file.size();
+        ObjMaterial* material = nullptr;
+        while(p < end){
+            skipBlanks(p, end);
+            const char* keyStart = p;
+            while(p < end && !isBlank(*p) && *p != '\n')
+                ++p;
+            std::string key(keyStart, p);
+            if(key == "newmtl")
+                material = &materials[restOfLine(p, end)];
+            else if(material && key == "map_Kd")
+                material->diffuse = restOfLine(p, end);
+            else if(material && key == "map_Ks")
+                material->specular = restOfLine(p, end);
+            else if(material && (key == "map_Bump" || key == "map_bump" || key == "bump"))
+                material->bump = restOfLine(p, end);
+            else if(material && key == "map_Ka")
+                material->ambient = restOfLine(p, end);
+            skipLine(p, end);
+        }
+    }
+};
+
+// Fills the model from an OBJ file with the native loader. Textures are bound under the same
+// names Model gives Assimp's diffuse, specular, height and ambient maps. Returns false for other
+// formats or files it could not read, the caller then falls back to Assimp.
+inline bool loadObjModel(const std::string& path, JobSystem& jobs, Model& model){
+    if(path.size() < 4 || path.compare(path.size() - 4, 4, ".obj") != 0)
+        return false;
+    ObjLoader loader;
+    if(!loader.load(path, jobs))
+        return false;
+
+    model.directory = path.substr(0, path.find_last_of('/'));
+    auto texture = [&model](const std::string& file, const char* type, std::vector<Texture>& textures){
+        if(file.empty())
+            return;
+        for(const Texture& loaded : model.textures_loaded){
+            if(loaded.path == file){
+                textures.push_back(loaded);
+                return;
+            }
+        }
+        Texture loaded;
+        loaded.id = TextureFromFile(file.c_str(), model.directory);
+        loaded.type = type;
+        loaded.path = file;
+        textures.push_back(loaded);
+        model.textures_loaded.push_back(loaded);
+    };
+    for(ObjLoader::MeshData& mesh : loader.meshes){
+        std::vector<Texture> textures;
+        auto material = loader.materials.find(mesh.material);
+        if(material != loader.materials.end()){
+            texture(material->second.diffuse, "texture_diffuse", textures);
+            texture(material->second.specular, "texture_specular", textures);
+            texture(material->second.bump, "texture_normal", textures);
+            texture(material->second.ambient, "texture_height", textures);
+        }
+        model.meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), textures));
+    }
+    return true;
+}
+
+#endif //MATF_RG_GAME_OMEGA_OBJLOADER_HPP
@@ -0,0 +1,258 @@
+#ifndef MATF_RG_GAME_OMEGA_PROFILER_HPP
+#define MATF_RG_GAME_OMEGA_PROFILER_HPP
+
+#include <glad/glad.h>
+#include "imgui.h"
+#include "rg/GLDebug.hpp"
+#include "rg/RenderStats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// timestamp queries are read back this many frames later so reading them never stalls
+#define PROFILER_FRAMES 4
+#define PROFILER_MAX_SECTIONS 32
+#define PROFILER_SMOOTHING 0.05f
+// frame intervals the pacing statistics are taken over
+#define PROFILER_PACING_FRAMES 120
+#define PROFILER_LATENCY_SAMPLES 32
+
+// CPU and GPU timings of named sections of the frame. Sections may nest, GPU times come from
+// GL_TIMESTAMP queries so nesting works. Whole frame times are also kept per render mode so
+// different renderer paths can be compared side by side. The time between frame starts is
+// kept as well, its spread is the jitter the frame pacing leaves, and so is the time from a key
+// press to the swap of the first frame showing it. Sections are also the passes render
+// statistics are counted per, when there are any, and the debug groups of the GL debug layer.
+class Profiler {
+public:
+    Profiler(){
+        glGenQueries(PROFILER_FRAMES * PROFILER_MAX_SECTIONS * 2, queries);
+        frame = 0;
+        lastFrameStart = 0.0;
+        intervalCount = 0;
+        latencyCount = 0;
+    }
+
+    ~Profiler(){
+        glDeleteQueries(PROFILER_FRAMES * PROFILER_MAX_SECTIONS * 2, queries);
+    }
+
+    void setRenderStats(RenderStats* stats){
+        renderStats = stats;
+    }
+
+    void beginFrame(const char* mode){
+        if(renderStats)
+            renderStats->beginFrame();
+        double start = now();
+        if(frame > 0)
+            intervals[intervalCount++ % PROFILER_PACING_FRAMES] = (float)(start - lastFrameStart);
+        lastFrameStart = start;
+        FrameSlot& slot = slots[frame % PROFILER_FRAMES];
+        collect(slot);
+        slot.records.clear();
+        slot.mode = modeIndex(mode);
+        stack.clear();
+        begin("Frame");
+    }
+
+    void endFrame(){
+        end();
+        frame++;
+        if(renderStats)
+            renderStats->endFrame();
+    }
+
+    void begin(const char* name){
+        if(renderStats)
+            renderStats->beginPass(name);
+        GL_DEBUG_BEGIN(name);
+        FrameSlot& slot = slots[frame % PROFILER_FRAMES];
+        if(slot.records.size() >= PROFILER_MAX_SECTIONS){
+            stack.push_back(-1);
+            return;
+        }
+        Record record;
+        record.section = sectionIndex(name);
+        record.cpuStart = now();
+        record.cpuEnd = record.cpuStart;
+        glQueryCounter(query(slot.records.size(), 0), GL_TIMESTAMP);
+        stack.push_back(slot.records.size());
+        slot.records.push_back(record);
+    }
+
+    void end(){
+        if(stack.empty())
+            return;
+        if(renderStats)
+            renderStats->endPass();
+        GL_DEBUG_END();
+        int index = stack.back();
+        stack.pop_back();
+        if(index < 0)
+            return;
+        FrameSlot& slot = slots[frame % PROFILER_FRAMES];
+        slot.records[index].cpuEnd = now();
+        glQueryCounter(query(index, 1), GL_TIMESTAMP);
+    }
+
+    void inputLatency(float ms){
+        latencies[latencyCount++ % PROFILER_LATENCY_SAMPLES] = ms;
+    }
+
+    // smoothed GPU time of a section in milliseconds, 0 if it was never measured
+    float gpuMs(const char* name) const {
+        for(const Section& section : sections)
+            if(std::strcmp(section.name, name) == 0)
+                return section.gpuMs;
+        return 0.0f;
+    }
+
+    float cpuMs(const char* name) const {
+        for(const Section& section : sections)
+            if(std::strcmp(section.name, name) == 0)
+                return section.cpuMs;
+        return 0.0f;
+    }
+
+    void drawImGui(){
+        ImGui::Begin("Profiler");
+        ImGui::Text("%-16s %9s %9s", "Section", "CPU ms", "GPU ms");
+        for(const Section& section : sections)
+            ImGui::Text("%-16s %9.3f %9.3f", section.name, section.cpuMs, section.gpuMs);
+        ImGui::Separator();
+        ImGui::Text("%-16s %9s %9s %8s", "Render mode", "CPU ms", "GPU ms", "Frames");
+        for(const Mode& mode : modes)
+            ImGui::Text("%-16s %9.3f %9.3f %8u", mode.name.c_str(), mode.cpuMs, mode.gpuMs, mode.frames);
+        ImGui::Separator();
+        unsigned int count = std::min(intervalCount, (unsigned int)PROFILER_PACING_FRAMES);
+        if(count > 0){
+            float mean = 0.0f, worst = 0.0f;
+            for(unsigned int i = 0; i < count; ++i){
+                mean += intervals[i];
+                worst = std::max(worst, intervals[i]);
+            }
+            mean /= count;
+            float variance = 0.0f;
+            for(unsigned int i = 0; i < count; ++i)
+                variance += (intervals[i] - mean) * (intervals[i] - mean);
+            ImGui::Text("Frame interval %.3f ms (%.1f fps)", mean, mean > 0.0f ? 1000.0f / mean : 0.0f);
+            ImGui::Text("Jitter %.3f ms, worst frame %.3f ms", std::sqrt(variance / count), worst);
+        }
+        count = std::min(latencyCount, (unsigned int)PROFILER_LATENCY_SAMPLES);
+        if(count > 0){
+            float mean = 0.0f, worst = 0.0f;
+            for(unsigned int i = 0; i < count; ++i){
+                mean += latencies[i];
+                worst = std::max(worst, latencies[i]);
+            }
+            ImGui::Text("Input to swap %.2f ms, average %.2f ms, worst %.2f ms",
+                        latencies[(latencyCount - 1) % PROFILER_LATENCY_SAMPLES], mean / count, worst);
+        }
+        ImGui::End();
+    }
+
+private:
+
+    struct Record {
+        int section;
+        double cpuStart;
+        double cpuEnd;
+    };
+
+    struct FrameSlot {
+        std::vector<Record> records;
+        int mode = -1;
+    };
+
+    struct Section {
+        const char* name;
+        float cpuMs;
+        float gpuMs;
+    };
+
+    struct Mode {
+        std::string name;
+        float cpuMs;
+        float gpuMs;
+        unsigned int frames;
+    };
+
+    GLuint queries[PROFILER_FRAMES * PROFILER_MAX_SECTIONS * 2];
+    FrameSlot slots[PROFILER_FRAMES];
+    std::vector<Section> sections;
+    std::vector<Mode> modes;
+    std::vector<int> stack;
+    RenderStats* renderStats = nullptr;
+    unsigned long frame;
+    double lastFrameStart;
+    float intervals[PROFILER_PACING_FRAMES];
+    unsigned int intervalCount;
+    float latencies[PROFILER_LATENCY_SAMPLES];
+    unsigned int latencyCount;
+
+    GLuint query(unsigned int record, unsigned int which) const {
+        return queries[((frame % PROFILER_FRAMES) * PROFILER_MAX_SECTIONS + record) * 2 + which];
+    }
+
+    static double now(){
+        using namespace std::chrono;
+        return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    static float smooth(float average, float sample, bool first){
+        return first ? sample : average + (sample - average) * PROFILER_SMOOTHING;
+    }
+
+    int sectionIndex(const char* name){
+        for(unsigned int i = 0; i < sections.size(); ++i)
+            if(std::strcmp(sections[i].name, name) == 0)
+                return i;
+        sections.push_back({name, 0.0f, 0.0f});
+        return sections.size() - 1;
+    }
+
+    int modeIndex(const char* name){
+        for(unsigned int i = 0; i < modes.size(); ++i)
+            if(modes[i].name == name)
+                return i;
+        modes.push_back({name, 0.0f, 0.0f, 0});
+        return modes.size() - 1;
+    }
+
+    // reads back the timings recorded PROFILER_FRAMES frames ago into the smoothed averages
+    void collect(const FrameSlot& slot){
+        for(unsigned int i = 0; i < slot.records.size(); ++i){
+            const Record& record = slot.records[i];
+            GLuint startQuery = query(i, 0), endQuery = query(i, 1);
+            GLint available = 0;
+            glGetQueryObjectiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available)
+                continue;
+            GLuint64 start, end;
+            glGetQueryObjectui64v(startQuery, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &end);
+            float gpu = (float)((end - start) / 1.0e6);
+            float cpu = (float)(record.cpuEnd - record.cpuStart);
+
+            Section& section = sections[record.section];
+            bool first = section.gpuMs == 0.0f && section.cpuMs == 0.0f;
+            section.gpuMs = smooth(section.gpuMs, gpu, first);
+            section.cpuMs = smooth(section.cpuMs, cpu, first);
+
+            // the first record of a frame is always the whole frame
+            if(i == 0 && slot.mode >= 0){
+                Mode& mode = modes[slot.mode];
+                mode.gpuMs = smooth(mode.gpuMs, gpu, mode.frames == 0);
+                mode.cpuMs = smooth(mode.cpuMs, cpu, mode.frames == 0);
+                mode.frames++;
+            }
+        }
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_PROFILER_HPP
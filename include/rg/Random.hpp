@@ -0,0 +1,39 @@
+#ifndef MATF_RG_GAME_OMEGA_RANDOM_HPP
+#define MATF_RG_GAME_OMEGA_RANDOM_HPP
+
+#include <cstdint>
+
+// PCG32 (XSH RR) generator. Small state and no libc calls, the same seed always gives the same sequence.
+class Random {
+public:
+    explicit Random(uint64_t seed = 0x853c49e6748fea9bULL){
+        reseed(seed);
+    }
+
+    void reseed(uint64_t seed, uint64_t stream = 0xda3e39cb94b95bdbULL){
+        state = 0;
+        increment = (stream << 1u) | 1u;
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next(){
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rotation = (uint32_t)(old >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+    }
+
+    // uniform in [0, n) by multiply-shift, no division and no rejection loop
+    uint32_t below(uint32_t n){
+        return (uint32_t)(((uint64_t)next() * n) >> 32u);
+    }
+
+private:
+    uint64_t state;
+    uint64_t increment;
+};
+
+#endif //MATF_RG_GAME_OMEGA_RANDOM_HPP
@@ -0,0 +1,80 @@
+#ifndef MATF_RG_GAME_OMEGA_RENDERFORMATS_HPP
+#define MATF_RG_GAME_OMEGA_RENDERFORMATS_HPP
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+enum RenderFormat {
+    // 8 bytes a texel, the only one of these every GL 3.3 implementation has to render to
+    FORMAT_RGBA16F,
+    // 4 bytes, floats without sign or alpha, enough for HDR color
+    FORMAT_R11G11B10F,
+    // 4 bytes, normalized so values above 1 are clamped
+    FORMAT_RGB10A2,
+    FORMAT_COUNT
+};
+
+// Color formats the HDR targets can use, the scene only the ones that don't clamp. Renderability is implementation defined for some of
+// them, each is tried once on a small framebuffer, with and without multisampling, and one that
+// fails is replaced by RGBA16F.
+class RenderFormats {
+public:
+    static const char* name(int format){
+        static const char* names[FORMAT_COUNT] = {"RGBA16F", "R11G11B10F", "RGB10A2"};
+        return names[format];
+    }
+
+    static GLenum internalFormat(int format){
+        static const GLenum formats[FORMAT_COUNT] = {GL_RGBA16F, GL_R11F_G11F_B10F, GL_RGB10_A2};
+        return formats[format];
+    }
+
+    void probe(int samples){
+        for(int format = 0; format < FORMAT_COUNT; ++format){
+            renderable[format][0] = tryFormat(internalFormat(format), 0);
+            renderable[format][1] = tryFormat(internalFormat(format), samples);
+        }
+    }
+
+    // the format to use in place of the one asked for, warns the first time it has to fall back.
+    // A target holding the HDR scene, hdr, can't use a format that clamps.
+    int resolve(int format, bool multisampled, bool hdr = false){
+        if(format < 0 || format >= FORMAT_COUNT || (hdr && format == FORMAT_RGB10A2))
+            return FORMAT_RGBA16F;
+        if(renderable[format][multisampled])
+            return format;
+        if(!warned[format][multisampled])
+            std::cerr << "WARNING::RENDER_FORMAT " << name(format) << (multisampled ? " multisampled" : "")
+                      << " is not renderable, using RGBA16F" << std::endl;
+        warned[format][multisampled] = true;
+        return FORMAT_RGBA16F;
+    }
+
+private:
+    // until probed everything is taken to be renderable
+    bool renderable[FORMAT_COUNT][2] = {{true, true}, {true, true}, {true, true}};
+    bool warned[FORMAT_COUNT][2] = {};
+
+    static bool tryFormat(GLenum internalFormat, int samples){
+        GLenum target = samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        GLuint texture, framebuffer;
+        glGenTextures(1, &texture);
+        glBindTexture(target, texture);
+        if(samples > 0)
+            glTexImage2DMultisample(target, samples, internalFormat, 4, 4, GL_TRUE);
+        else
+            glTexImage2D(target, 0, internalFormat, 4, 4, 0, GL_RGBA, GL_FLOAT, NULL);
+        glBindTexture(target, 0);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, texture, 0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+        return complete;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_RENDERFORMATS_HPP
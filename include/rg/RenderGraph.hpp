@@ -0,0 +1,348 @@
+#ifndef MATF_RG_GAME_OMEGA_RENDERGRAPH_HPP
+#define MATF_RG_GAME_OMEGA_RENDERGRAPH_HPP
+
+#include <glad/glad.h>
+#include "rg/GLDebug.hpp"
+#include "rg/GpuMemory.hpp"
+#include "rg/Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct RenderTargetDesc {
+    GLenum internalFormat;
+    int width;
+    int height;
+
+    bool operator==(const RenderTargetDesc& other) const {
+        return internalFormat == other.internalFormat && width == other.width && height == other.height;
+    }
+};
+
+// The passes of a frame and the resources they read and write, declared anew every frame.
+// Passes nothing needed reads from are culled, working back from the outputs. Resources are
+// either imported, owned elsewhere and persistent, or transient textures the graph owns.
+// Transient textures only live from the pass writing them to the last pass reading them and
+// ones whose lifetimes don't overlap share a texture when their formats and sizes match, so
+// a resource written by each step of a chain, like the bloom blur, ping-pongs between two
+// textures without the passes knowing. Textures and framebuffers are kept from frame to frame,
+// a graph that doesn't change makes no GL calls of its own besides binding.
+class RenderGraph {
+public:
+    typedef std::function<void()> PassFunction;
+
+    ~RenderGraph(){
+        for(const Framebuffer& framebuffer : framebuffers)
+            glDeleteFramebuffers(1, &framebuffer.id);
+        for(const Target& target : targets){
+            GpuMemory::tracker().release(GPU_TEXTURE, target.texture);
+            glDeleteTextures(1, &target.texture);
+        }
+    }
+
+    // call before declaring the frame's passes
+    void reset(){
+        resources.clear();
+        passes.clear();
+    }
+
+    int importTexture(const char* name, GLuint texture){
+        return addResource(name, texture, -1, nullptr);
+    }
+
+    // passes writing it get the framebuffer bound
+    int importFramebuffer(const char* name, GLuint framebuffer){
+        return addResource(name, 0, framebuffer, nullptr);
+    }
+
+    int createTexture(const char* name, const RenderTargetDesc& desc){
+        return addResource(name, 0, -1, &desc);
+    }
+
+    // what the frame is for, passes only contributing to something else are culled
+    void markOutput(int resource){
+        resources[resource].output = true;
+    }
+
+    // passes run in the order they are added. A pass writing transient textures draws into a
+    // framebuffer with them attached in the order given, one writing an imported framebuffer
+    // draws into that.
+    void addPass(const char* name, std::initializer_list<int> reads, std::initializer_list<int> writes, PassFunction execute){
+        Pass pass;
+        pass.name = name;
+        pass.reads.assign(reads.begin(), reads.end());
+        pass.writes.assign(writes.begin(), writes.end());
+        pass.execute = std::move(execute);
+        pass.live = false;
+        pass.framebuffer = -1;
+        passes.push_back(std::move(pass));
+    }
+
+    void compile(){
+        cull();
+        assignTargets();
+        releaseUnused();
+        for(Pass& pass : passes)
+            if(pass.live)
+                pass.framebuffer = framebufferFor(pass);
+    }
+
+    // passes of the same name in a row are timed as one profiler section, if there is a profiler
+    void execute(Profiler* profiler){
+        const char* section = nullptr;
+        for(Pass& pass : passes){
+            if(!pass.live)
+                continue;
+            if(profiler && (!section || std::strcmp(section, pass.name) != 0)){
+                if(section)
+                    profiler->end();
+                section = pass.name;
+                profiler->begin(section);
+            }
+            if(pass.framebuffer >= 0)
+                glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+            pass.execute();
+        }
+        if(section)
+            profiler->end();
+    }
+
+    // the texture a resource is in this frame, valid while the passes execute
+    GLuint texture(int resource) const {
+        const Resource& entry = resources[resource];
+        return entry.target >= 0 ? targets[entry.target].texture : entry.texture;
+    }
+
+    unsigned int passCount() const {
+        return passes.size();
+    }
+
+    unsigned int livePassCount() const {
+        unsigned int count = 0;
+        for(const Pass& pass : passes)
+            count += pass.live;
+        return count;
+    }
+
+    // transient textures used by the frame against the textures they were placed in
+    unsigned int transientCount() const {
+        unsigned int count = 0;
+        for(const Resource& resource : resources)
+            count += resource.target >= 0;
+        return count;
+    }
+
+    unsigned int targetCount() const {
+        return targets.size();
+    }
+
+    uint64_t targetBytes() const {
+        uint64_t bytes = 0;
+        for(const Target& target : targets)
+            bytes += GpuMemory::textureBytes(target.desc.internalFormat, target.desc.width, target.desc.height);
+        return bytes;
+    }
+
+private:
+    struct Resource {
+        const char* name;
+        bool transient;
+        RenderTargetDesc desc;
+        GLuint texture;
+        int framebuffer;
+        bool output;
+        // first and last live pass using it, and the texture it was placed in
+        int firstUse;
+        int lastUse;
+        int target;
+    };
+
+    struct Pass {
+        const char* name;
+        std::vector<int> reads;
+        std::vector<int> writes;
+        PassFunction execute;
+        bool live;
+        int framebuffer;
+    };
+
+    struct Target {
+        RenderTargetDesc desc;
+        GLuint texture;
+        // last pass of the frame the texture is taken until
+        int busyUntil;
+    };
+
+    struct Framebuffer {
+        std::vector<GLuint> attachments;
+        GLuint id;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<Target> targets;
+    std::vector<Framebuffer> framebuffers;
+    std::vector<bool> needed;
+
+    int addResource(const char* name, GLuint texture, int framebuffer, const RenderTargetDesc* desc){
+        Resource resource;
+        resource.name = name;
+        resource.transient = desc != nullptr;
+        resource.desc = desc ? *desc : RenderTargetDesc{GL_NONE, 0, 0};
+        resource.texture = texture;
+        resource.framebuffer = framebuffer;
+        resource.output = false;
+        resource.firstUse = -1;
+        resource.lastUse = -1;
+        resource.target = -1;
+        resources.push_back(resource);
+        return resources.size() - 1;
+    }
+
+    // walks back from the outputs, a pass is live if it writes something a later live pass
+    // reads. Imported resources stay needed once they are, their earlier writes contribute too.
+    void cull(){
+        needed.assign(resources.size(), false);
+        for(unsigned int i = 0; i < resources.size(); ++i)
+            needed[i] = resources[i].output;
+        for(int i = (int)passes.size() - 1; i >= 0; --i){
+            Pass& pass = passes[i];
+            pass.live = false;
+            for(int resource : pass.writes)
+                pass.live = pass.live || needed[resource];
+            if(!pass.live)
+                continue;
+            for(int resource : pass.writes)
+                if(resources[resource].transient && !resources[resource].output)
+                    needed[resource] = false;
+            for(int resource : pass.reads)
+                needed[resource] = true;
+        }
+    }
+
+    void assignTargets(){
+        for(int i = 0; i < (int)passes.size(); ++i){
+            if(!passes[i].live)
+                continue;
+            for(int resource : passes[i].reads)
+                use(resource, i);
+            for(int resource : passes[i].writes)
+                use(resource, i);
+        }
+        for(Target& target : targets)
+            target.busyUntil = -1;
+        // resources are placed in the order their lifetimes start, first fit
+        for(int i = 0; i < (int)passes.size(); ++i){
+            if(!passes[i].live)
+                continue;
+            for(int index : passes[i].writes){
+                Resource& resource = resources[index];
+                if(!resource.transient || resource.target >= 0 || resource.firstUse != i)
+                    continue;
+                for(unsigned int t = 0; t < targets.size() && resource.target < 0; ++t)
+                    if(targets[t].busyUntil < i && targets[t].desc == resource.desc)
+                        resource.target = t;
+                if(resource.target < 0)
+                    resource.target = createTarget(resource.desc);
+                targets[resource.target].busyUntil = resource.lastUse;
+            }
+        }
+    }
+
+    // textures the frame had no use for are freed, turning bloom off gives back its targets
+    void releaseUnused(){
+        std::vector<int> remap(targets.size(), -1);
+        unsigned int kept = 0;
+        for(unsigned int t = 0; t < targets.size(); ++t){
+            if(targets[t].busyUntil >= 0){
+                remap[t] = kept;
+                targets[kept++] = targets[t];
+                continue;
+            }
+            for(unsigned int f = 0; f < framebuffers.size(); ){
+                const std::vector<GLuint>& attachments = framebuffers[f].attachments;
+                if(std::find(attachments.begin(), attachments.end(), targets[t].texture) != attachments.end()){
+                    glDeleteFramebuffers(1, &framebuffers[f].id);
+                    framebuffers.erase(framebuffers.begin() + f);
+                }
+                else
+                    f++;
+            }
+            GpuMemory::tracker().release(GPU_TEXTURE, targets[t].texture);
+            glDeleteTextures(1, &targets[t].texture);
+        }
+        if(kept == targets.size())
+            return;
+        targets.resize(kept);
+        for(Resource& resource : resources)
+            if(resource.target >= 0)
+                resource.target = remap[resource.target];
+    }
+
+    void use(int index, int pass){
+        Resource& resource = resources[index];
+        if(resource.firstUse < 0)
+            resource.firstUse = pass;
+        resource.lastUse = pass;
+    }
+
+    int createTarget(const RenderTargetDesc& desc){
+        Target target;
+        target.desc = desc;
+        target.busyUntil = -1;
+        glGenTextures(1, &target.texture);
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        std::string name = "Render graph target " + std::to_string(targets.size());
+        GL_DEBUG_LABEL(GL_TEXTURE, target.texture, name.c_str());
+        GpuMemory::tracker().texture(GPU_RENDER_TARGETS, target.texture, name.c_str(), desc.internalFormat, desc.width, desc.height);
+        targets.push_back(target);
+        return targets.size() - 1;
+    }
+
+    // -1 leaves the binding to the pass
+    int framebufferFor(const Pass& pass){
+        std::vector<GLuint> attachments;
+        for(int index : pass.writes){
+            const Resource& resource = resources[index];
+            if(resource.framebuffer >= 0)
+                return resource.framebuffer;
+            if(resource.transient)
+                attachments.push_back(targets[resource.target].texture);
+        }
+        if(attachments.empty())
+            return -1;
+        for(const Framebuffer& framebuffer : framebuffers)
+            if(framebuffer.attachments == attachments)
+                return framebuffer.id;
+
+        Framebuffer framebuffer;
+        framebuffer.attachments = attachments;
+        glGenFramebuffers(1, &framebuffer.id);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id);
+        std::vector<GLenum> drawBuffers;
+        for(unsigned int i = 0; i < attachments.size(); ++i){
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, attachments[i], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::RENDER_GRAPH_FRAMEBUFFER incomplete for " << pass.name << std::endl;
+        GL_DEBUG_LABEL(GL_FRAMEBUFFER, framebuffer.id, pass.name);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        framebuffers.push_back(framebuffer);
+        return framebuffer.id;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_RENDERGRAPH_HPP
@@ -0,0 +1,281 @@
+#ifndef MATF_RG_GAME_OMEGA_RENDERSTATS_HPP
+#define MATF_RG_GAME_OMEGA_RENDERSTATS_HPP
+
+#include <glad/glad.h>
+#include "imgui.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define RENDER_STATS_SMOOTHING 0.05f
+
+enum RenderCounter {
+    RENDER_DRAW_CALLS,
+    RENDER_TRIANGLES,
+    RENDER_PROGRAM_BINDS,
+    RENDER_TEXTURE_BINDS,
+    RENDER_UNIFORMS,
+    RENDER_BUFFER_BYTES,
+    RENDER_FBO_BINDS,
+    RENDER_BLITS,
+    RENDER_COUNTER_COUNT
+};
+
+// counts one call of a uniform function and forwards it to the driver
+#define RENDER_STATS_UNIFORM_HOOK(Name, Params, Args) \
+    static PFNGL##Name##PROC& real##Name(){ static PFNGL##Name##PROC proc = nullptr; return proc; } \
+    static void APIENTRY hook##Name Params { record(RENDER_UNIFORMS, 1); real##Name() Args; }
+
+#define RENDER_STATS_INSTALL(Name, gladName) \
+    real##Name() = gladName; \
+    gladName = hook##Name;
+
+// Per pass counts of what the frame submits to GL. The glad entry points of the counted calls
+// are swapped for hooks that count and forward, so every call is seen, ImGui's included, without
+// touching the call sites. Passes are the profiler's sections, a call counts towards the
+// innermost one.
+class RenderStats {
+public:
+    static const char* counterName(unsigned int counter){
+        static const char* names[RENDER_COUNTER_COUNT] = {"draw_calls", "triangles", "program_binds", "texture_binds",
+                                                          "uniforms", "buffer_bytes", "fbo_binds", "blits"};
+        return names[counter];
+    }
+
+    // the stats the hooks count into, null counts nothing
+    static RenderStats*& active(){
+        static RenderStats* stats = nullptr;
+        return stats;
+    }
+
+    // call once glad has loaded the entry points
+    static void installHooks(){
+        RENDER_STATS_INSTALL(DRAWARRAYS, glad_glDrawArrays)
+        RENDER_STATS_INSTALL(DRAWELEMENTS, glad_glDrawElements)
+        RENDER_STATS_INSTALL(DRAWELEMENTSBASEVERTEX, glad_glDrawElementsBaseVertex)
+        RENDER_STATS_INSTALL(USEPROGRAM, glad_glUseProgram)
+        RENDER_STATS_INSTALL(BINDTEXTURE, glad_glBindTexture)
+        RENDER_STATS_INSTALL(BINDFRAMEBUFFER, glad_glBindFramebuffer)
+        RENDER_STATS_INSTALL(BLITFRAMEBUFFER, glad_glBlitFramebuffer)
+        RENDER_STATS_INSTALL(BUFFERDATA, glad_glBufferData)
+        RENDER_STATS_INSTALL(BUFFERSUBDATA, glad_glBufferSubData)
+        RENDER_STATS_INSTALL(UNIFORM1I, glad_glUniform1i)
+        RENDER_STATS_INSTALL(UNIFORM3I, glad_glUniform3i)
+        RENDER_STATS_INSTALL(UNIFORM1F, glad_glUniform1f)
+        RENDER_STATS_INSTALL(UNIFORM2F, glad_glUniform2f)
+        RENDER_STATS_INSTALL(UNIFORM3F, glad_glUniform3f)
+        RENDER_STATS_INSTALL(UNIFORM4F, glad_glUniform4f)
+        RENDER_STATS_INSTALL(UNIFORM2FV, glad_glUniform2fv)
+        RENDER_STATS_INSTALL(UNIFORM3FV, glad_glUniform3fv)
+        RENDER_STATS_INSTALL(UNIFORM4FV, glad_glUniform4fv)
+        RENDER_STATS_INSTALL(UNIFORMMATRIX2FV, glad_glUniformMatrix2fv)
+        RENDER_STATS_INSTALL(UNIFORMMATRIX3FV, glad_glUniformMatrix3fv)
+        RENDER_STATS_INSTALL(UNIFORMMATRIX4FV, glad_glUniformMatrix4fv)
+    }
+
+    // every frame from here on is written as one line per pass that submitted anything
+    bool openCsv(const std::string& path){
+        csv.open(path, std::ios::trunc);
+        if(!csv){
+            std::cerr << "ERROR::RENDER_STATS could not write " << path << std::endl;
+            return false;
+        }
+        csv << "frame,pass";
+        for(unsigned int i = 0; i < RENDER_COUNTER_COUNT; ++i)
+            csv << ',' << counterName(i);
+        csv << '\n';
+        return true;
+    }
+
+    void beginFrame(){
+        for(Pass& pass : passes)
+            std::memset(pass.frame, 0, sizeof(pass.frame));
+        stack.clear();
+    }
+
+    void endFrame(){
+        for(Pass& pass : passes){
+            bool submitted = false;
+            std::memcpy(pass.last, pass.frame, sizeof(pass.frame));
+            for(unsigned int i = 0; i < RENDER_COUNTER_COUNT; ++i){
+                pass.average[i] = frames == 0 ? pass.frame[i] : pass.average[i] + (pass.frame[i] - pass.average[i]) * RENDER_STATS_SMOOTHING;
+                submitted = submitted || pass.frame[i] > 0;
+            }
+            if(csv.is_open() && submitted){
+                csv << frames << ',' << pass.name;
+                for(unsigned int i = 0; i < RENDER_COUNTER_COUNT; ++i)
+                    csv << ',' << pass.frame[i];
+                csv << '\n';
+            }
+        }
+        frames++;
+    }
+
+    void beginPass(const char* name){
+        stack.push_back(passIndex(name));
+    }
+
+    void endPass(){
+        if(!stack.empty())
+            stack.pop_back();
+    }
+
+    // counts of the last finished frame, 0 for passes that never ran
+    uint64_t lastFrame(const char* pass, RenderCounter counter) const {
+        for(const Pass& entry : passes)
+            if(std::strcmp(entry.name, pass) == 0)
+                return entry.last[counter];
+        return 0;
+    }
+
+    float average(const char* pass, RenderCounter counter) const {
+        for(const Pass& entry : passes)
+            if(std::strcmp(entry.name, pass) == 0)
+                return entry.average[counter];
+        return 0.0f;
+    }
+
+    void drawImGui(){
+        ImGui::Begin("Render stats");
+        ImGui::Text("last frame / moving average");
+        if(ImGui::BeginTable("counters", RENDER_COUNTER_COUNT + 1, ImGuiTableFlags_Borders | ImGuiTableFlags_ColumnsWidthFixed)){
+            ImGui::TableSetupColumn("pass");
+            for(unsigned int i = 0; i < RENDER_COUNTER_COUNT; ++i)
+                ImGui::TableSetupColumn(counterName(i));
+            ImGui::TableHeadersRow();
+            for(const Pass& pass : passes){
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(pass.name);
+                for(unsigned int i = 0; i < RENDER_COUNTER_COUNT; ++i){
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu / %.0f", (unsigned long long)pass.last[i], pass.average[i]);
+                }
+            }
+            ImGui::EndTable();
+        }
+        ImGui::End();
+    }
+
+private:
+    struct Pass {
+        const char* name;
+        uint64_t frame[RENDER_COUNTER_COUNT];
+        uint64_t last[RENDER_COUNTER_COUNT];
+        float average[RENDER_COUNTER_COUNT];
+    };
+
+    std::vector<Pass> passes;
+    std::vector<int> stack;
+    unsigned long frames = 0;
+    std::ofstream csv;
+
+    int passIndex(const char* name){
+        for(unsigned int i = 0; i < passes.size(); ++i)
+            if(std::strcmp(passes[i].name, name) == 0)
+                return i;
+        Pass pass;
+        pass.name = name;
+        std::memset(pass.frame, 0, sizeof(pass.frame));
+        std::memset(pass.last, 0, sizeof(pass.last));
+        std::memset(pass.average, 0, sizeof(pass.average));
+        passes.push_back(pass);
+        return passes.size() - 1;
+    }
+
+    // calls outside of any pass, like loading, are not counted
+    static void record(RenderCounter counter, uint64_t amount){
+        RenderStats* stats = active();
+        if(stats && !stats->stack.empty())
+            stats->passes[stats->stack.back()].frame[counter] += amount;
+    }
+
+    static uint64_t triangles(GLenum mode, GLsizei count){
+        if(mode == GL_TRIANGLES)
+            return count / 3;
+        if(mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+            return count > 2 ? count - 2 : 0;
+        return 0;
+    }
+
+    static void draw(GLenum mode, GLsizei count){
+        record(RENDER_DRAW_CALLS, 1);
+        record(RENDER_TRIANGLES, triangles(mode, count));
+    }
+
+    static PFNGLDRAWARRAYSPROC& realDRAWARRAYS(){ static PFNGLDRAWARRAYSPROC proc = nullptr; return proc; }
+    static void APIENTRY hookDRAWARRAYS(GLenum mode, GLint first, GLsizei count){
+        draw(mode, count);
+        realDRAWARRAYS()(mode, first, count);
+    }
+
+    static PFNGLDRAWELEMENTSPROC& realDRAWELEMENTS(){ static PFNGLDRAWELEMENTSPROC proc = nullptr; return proc; }
+    static void APIENTRY hookDRAWELEMENTS(GLenum mode, GLsizei count, GLenum type, const void* indices){
+        draw(mode, count);
+        realDRAWELEMENTS()(mode, count, type, indices);
+    }
+
+    static PFNGLDRAWELEMENTSBASEVERTEXPROC& realDRAWELEMENTSBASEVERTEX(){ static PFNGLDRAWELEMENTSBASEVERTEXPROC proc = nullptr; return proc; }
+    static void APIENTRY hookDRAWELEMENTSBASEVERTEX(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex){
+        draw(mode, count);
+        realDRAWELEMENTSBASEVERTEX()(mode, count, type, indices, baseVertex);
+    }
+
+    static PFNGLUSEPROGRAMPROC& realUSEPROGRAM(){ static PFNGLUSEPROGRAMPROC proc = nullptr; return proc; }
+    static void APIENTRY hookUSEPROGRAM(GLuint program){
+        record(RENDER_PROGRAM_BINDS, 1);
+        realUSEPROGRAM()(program);
+    }
+
+    static PFNGLBINDTEXTUREPROC& realBINDTEXTURE(){ static PFNGLBINDTEXTUREPROC proc = nullptr; return proc; }
+    static void APIENTRY hookBINDTEXTURE(GLenum target, GLuint texture){
+        record(RENDER_TEXTURE_BINDS, 1);
+        realBINDTEXTURE()(target, texture);
+    }
+
+    static PFNGLBINDFRAMEBUFFERPROC& realBINDFRAMEBUFFER(){ static PFNGLBINDFRAMEBUFFERPROC proc = nullptr; return proc; }
+    static void APIENTRY hookBINDFRAMEBUFFER(GLenum target, GLuint framebuffer){
+        record(RENDER_FBO_BINDS, 1);
+        realBINDFRAMEBUFFER()(target, framebuffer);
+    }
+
+    static PFNGLBLITFRAMEBUFFERPROC& realBLITFRAMEBUFFER(){ static PFNGLBLITFRAMEBUFFERPROC proc = nullptr; return proc; }
+    static void APIENTRY hookBLITFRAMEBUFFER(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0,
+                                             GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter){
+        record(RENDER_BLITS, 1);
+        realBLITFRAMEBUFFER()(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    static PFNGLBUFFERDATAPROC& realBUFFERDATA(){ static PFNGLBUFFERDATAPROC proc = nullptr; return proc; }
+    static void APIENTRY hookBUFFERDATA(GLenum target, GLsizeiptr size, const void* data, GLenum usage){
+        // allocating without data uploads nothing
+        if(data)
+            record(RENDER_BUFFER_BYTES, size);
+        realBUFFERDATA()(target, size, data, usage);
+    }
+
+    static PFNGLBUFFERSUBDATAPROC& realBUFFERSUBDATA(){ static PFNGLBUFFERSUBDATAPROC proc = nullptr; return proc; }
+    static void APIENTRY hookBUFFERSUBDATA(GLenum target, GLintptr offset, GLsizeiptr size, const void* data){
+        record(RENDER_BUFFER_BYTES, size);
+        realBUFFERSUBDATA()(target, offset, size, data);
+    }
+
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM1I, (GLint location, GLint v0), (location, v0))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM3I, (GLint location, GLint v0, GLint v1, GLint v2), (location, v0, v1, v2))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM1F, (GLint location, GLfloat v0), (location, v0))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM2F, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM3F, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM4F, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM2FV, (GLint location, GLsizei count, const GLfloat* value), (location, count, value))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM3FV, (GLint location, GLsizei count, const GLfloat* value), (location, count, value))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORM4FV, (GLint location, GLsizei count, const GLfloat* value), (location, count, value))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORMMATRIX2FV, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORMMATRIX3FV, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value))
+    RENDER_STATS_UNIFORM_HOOK(UNIFORMMATRIX4FV, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value))
+};
+
+#endif //MATF_RG_GAME_OMEGA_RENDERSTATS_HPP
@@ -0,0 +1,160 @@
+#ifndef MATF_RG_GAME_OMEGA_REPLAY_HPP
+#define MATF_RG_GAME_OMEGA_REPLAY_HPP
+
+#include "rg/Track.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// "RGRP" read as a little endian word
+#define REPLAY_MAGIC 0x50524752u
+#define REPLAY_VERSION 2u
+// event count of a frame is stored in a byte, more events are carried over into zero length frames
+#define REPLAY_MAX_FRAME_EVENTS 255
+
+// game inputs that change the simulation, everything else is left out of a replay
+enum ReplayEvent : uint8_t {
+    REPLAY_LEFT,
+    REPLAY_RIGHT,
+    REPLAY_RESET
+};
+
+// Log layout, all little endian:
+//  header - u32 magic, u32 version, u64 session seed, u32 lanes, u32 rows per chunk, f32 speed
+//  frame  - f32 frame delta, u8 event count, one u8 per event
+// The obstacle rules of the session are stored with the seed since they change what it generates.
+// Events are stamped with the frame they are applied before, which is what makes playback
+// step the game exactly as it was played.
+class ReplayRecorder {
+public:
+    bool open(const std::string& path, uint64_t seed, uint32_t lanes, uint32_t rowsPerChunk, float speed){
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if(!file){
+            std::cerr << "ERROR::REPLAY could not write " << path << std::endl;
+            return false;
+        }
+        write(REPLAY_MAGIC);
+        write(REPLAY_VERSION);
+        write(seed);
+        write(lanes);
+        write(rowsPerChunk);
+        write(speed);
+        return true;
+    }
+
+    void event(ReplayEvent event){
+        pending.push_back(event);
+    }
+
+    // records the delta of the frame about to be simulated together with the events since the last one
+    void frame(float deltaTime){
+        size_t written = 0;
+        do {
+            size_t count = std::min(pending.size() - written, (size_t)REPLAY_MAX_FRAME_EVENTS);
+            // only the last chunk carries the frame delta, the overflow ones do not advance time
+            write(written + count == pending.size() ? deltaTime : 0.0f);
+            write((uint8_t)count);
+            file.write((const char*)pending.data() + written, count);
+            written += count;
+        } while(written < pending.size());
+        pending.clear();
+    }
+
+private:
+    std::ofstream file;
+    std::vector<uint8_t> pending;
+
+    template<typename T>
+    void write(T value){
+        file.write((const char*)&value, sizeof(T));
+    }
+};
+
+// Reads a whole log up front so playback never touches the disk
+class ReplayPlayer {
+public:
+    bool open(const std::string& path){
+        std::ifstream file(path, std::ios::binary);
+        if(!file){
+            std::cerr << "ERROR::REPLAY could not read " << path << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        cursor = 0;
+        uint32_t magic = 0, version = 0;
+        if(!read(magic) || !read(version) || magic != REPLAY_MAGIC || version != REPLAY_VERSION
+           || !read(sessionSeed) || !read(laneCount) || !read(rows) || !read(obstacleSpeed)){
+            std::cerr << "ERROR::REPLAY " << path << " is not a version " << REPLAY_VERSION << " replay" << std::endl;
+            data.clear();
+            return false;
+        }
+        // the recorder only ever writes what the track accepts, anything else is a damaged file
+        if(laneCount < 2 || laneCount > TRACK_MAX_LANES || rows < 1 || rows > TRACK_MAX_ROWS
+           || !std::isfinite(obstacleSpeed) || obstacleSpeed <= 0.0f){
+            std::cerr << "ERROR::REPLAY " << path << " has " << laneCount << " lanes, " << rows
+                      << " rows per chunk and speed " << obstacleSpeed << std::endl;
+            data.clear();
+            return false;
+        }
+        frames = 0;
+        return true;
+    }
+
+    // next recorded frame, false once the log is exhausted
+    bool nextFrame(float& deltaTime, std::vector<ReplayEvent>& events){
+        uint8_t count = 0;
+        if(!read(deltaTime) || !read(count) || cursor + count > data.size())
+            return false;
+        // no indexing, the cursor is at the end after a last frame without events
+        events.assign((const ReplayEvent*)(data.data() + cursor), (const ReplayEvent*)(data.data() + cursor) + count);
+        cursor += count;
+        frames++;
+        return true;
+    }
+
+    uint64_t seed() const {
+        return sessionSeed;
+    }
+
+    uint32_t lanes() const {
+        return laneCount;
+    }
+
+    uint32_t rowsPerChunk() const {
+        return rows;
+    }
+
+    float speed() const {
+        return obstacleSpeed;
+    }
+
+    unsigned int framesPlayed() const {
+        return frames;
+    }
+
+private:
+    std::vector<uint8_t> data;
+    size_t cursor = 0;
+    uint64_t sessionSeed = 0;
+    uint32_t laneCount = 0;
+    uint32_t rows = 0;
+    float obstacleSpeed = 0.0f;
+    unsigned int frames = 0;
+
+    template<typename T>
+    bool read(T& value){
+        if(cursor + sizeof(T) > data.size())
+            return false;
+        std::copy(&data[cursor], &data[cursor] + sizeof(T), (uint8_t*)&value);
+        cursor += sizeof(T);
+        return true;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_REPLAY_HPP
@@ -0,0 +1,163 @@
+#ifndef MATF_RG_GAME_OMEGA_SETTINGS_HPP
+#define MATF_RG_GAME_OMEGA_SETTINGS_HPP
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// "RGST" read as a little endian word
+#define SETTINGS_MAGIC 0x54534752u
+#define SETTINGS_VERSION 1u
+
+enum SettingType : uint8_t {
+    SETTING_BOOL,
+    SETTING_INT,
+    SETTING_UINT,
+    SETTING_UINT64,
+    SETTING_FLOAT,
+    SETTING_VEC3
+};
+
+// File layout, all little endian:
+//  header - u32 magic, u32 version, u32 field count
+//  field  - u16 tag, u8 type, u8 size, size bytes of value
+// A field is found by its tag, not by where it is in the file, so fields can be added and
+// reordered freely. Fields the schema doesn't know, or that changed type, are skipped and the
+// value keeps its default. Tags must never be reused for something else.
+class SettingsSchema {
+public:
+    void field(uint16_t tag, const char* name, bool& value){
+        add(tag, name, SETTING_BOOL, &value);
+    }
+
+    void field(uint16_t tag, const char* name, int& value){
+        add(tag, name, SETTING_INT, &value);
+    }
+
+    void field(uint16_t tag, const char* name, unsigned int& value){
+        add(tag, name, SETTING_UINT, &value);
+    }
+
+    void field(uint16_t tag, const char* name, unsigned long long& value){
+        add(tag, name, SETTING_UINT64, &value);
+    }
+
+    void field(uint16_t tag, const char* name, float& value){
+        add(tag, name, SETTING_FLOAT, &value);
+    }
+
+    void field(uint16_t tag, const char* name, glm::vec3& value){
+        add(tag, name, SETTING_VEC3, &value);
+    }
+
+    std::string encode() const {
+        std::string out;
+        append(out, (uint32_t)SETTINGS_MAGIC);
+        append(out, (uint32_t)SETTINGS_VERSION);
+        append(out, (uint32_t)fields.size());
+        for(const Field& field : fields){
+            append(out, field.tag);
+            append(out, (uint8_t)field.type);
+            uint8_t size = sizeOf(field.type);
+            append(out, size);
+            if(field.type == SETTING_BOOL)
+                append(out, (uint8_t)*(const bool*)field.value);
+            else
+                out.append((const char*)field.value, size);
+        }
+        return out;
+    }
+
+    // false if the data isn't a settings file, a truncated file still yields the fields before the cut
+    bool decode(const char* data, size_t size){
+        uint32_t header[3];
+        if(size < sizeof(header))
+            return false;
+        std::memcpy(header, data, sizeof(header));
+        if(header[0] != SETTINGS_MAGIC)
+            return false;
+        size_t position = sizeof(header);
+        for(uint32_t i = 0; i < header[2] && size - position >= 4; ++i){
+            uint16_t tag;
+            std::memcpy(&tag, data + position, sizeof(tag));
+            uint8_t type = data[position + 2];
+            uint8_t valueSize = data[position + 3];
+            position += 4;
+            if(valueSize > size - position)
+                break;
+            const Field* field = find(tag);
+            if(field && field->type == type && sizeOf(field->type) == valueSize){
+                if(field->type == SETTING_BOOL)
+                    *(bool*)field->value = data[position] != 0;
+                else
+                    std::memcpy(field->value, data + position, valueSize);
+            }
+            position += valueSize;
+        }
+        return true;
+    }
+
+    // one "tag name = value" line per field, for reading and diffing, not loaded back
+    std::string exportText() const {
+        std::ostringstream out;
+        out << "# settings version " << SETTINGS_VERSION << '\n';
+        for(const Field& field : fields){
+            out << field.tag << ' ' << field.name << " = ";
+            switch(field.type){
+                case SETTING_BOOL: out << (*(const bool*)field.value ? "true" : "false"); break;
+                case SETTING_INT: out << *(const int*)field.value; break;
+                case SETTING_UINT: out << *(const unsigned int*)field.value; break;
+                case SETTING_UINT64: out << *(const unsigned long long*)field.value; break;
+                case SETTING_FLOAT: out << *(const float*)field.value; break;
+                case SETTING_VEC3: {
+                    const glm::vec3& value = *(const glm::vec3*)field.value;
+                    out << value.x << ' ' << value.y << ' ' << value.z;
+                    break;
+                }
+            }
+            out << '\n';
+        }
+        return out.str();
+    }
+
+private:
+    struct Field {
+        uint16_t tag;
+        const char* name;
+        SettingType type;
+        void* value;
+    };
+
+    std::vector<Field> fields;
+
+    void add(uint16_t tag, const char* name, SettingType type, void* value){
+        fields.push_back({tag, name, type, value});
+    }
+
+    const Field* find(uint16_t tag) const {
+        for(const Field& field : fields)
+            if(field.tag == tag)
+                return &field;
+        return nullptr;
+    }
+
+    static uint8_t sizeOf(SettingType type){
+        switch(type){
+            case SETTING_BOOL: return 1;
+            case SETTING_UINT64: return 8;
+            case SETTING_VEC3: return 12;
+            default: return 4;
+        }
+    }
+
+    template<typename T>
+    static void append(std::string& out, T value){
+        out.append((const char*)&value, sizeof(T));
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_SETTINGS_HPP
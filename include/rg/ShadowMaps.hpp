@@ -0,0 +1,212 @@
+#ifndef MATF_RG_GAME_OMEGA_SHADOWMAPS_HPP
+#define MATF_RG_GAME_OMEGA_SHADOWMAPS_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+#include "rg/GLDebug.hpp"
+#include "rg/GpuMemory.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <iostream>
+
+#define CSM_CASCADES 3
+#define CSM_SIZE 1024
+// shadows are only cast up to this view distance
+#define CSM_MAX_DISTANCE 30.0f
+// blend between uniform and logarithmic cascade splits
+#define CSM_SPLIT_LAMBDA 0.75f
+// extra depth behind each cascade so casters outside the view still land in the map
+#define CSM_CASTER_PADDING 10.0f
+// first texture unit used by the shadow maps, the static layer uses it and the dynamic layer the next one
+#define CSM_TEXTURE_UNIT 7
+
+// Directional light cascaded shadow maps kept as two layers. The static layer holds the track
+// and is only re-rendered when the light, the camera or the static geometry version changes,
+// the dynamic layer holds what moves and is re-rendered every frame. Shaders take the nearer
+// occluder of the two.
+class ShadowMaps {
+public:
+    ShadowMaps(){
+        glGenTextures(2, textures);
+        for(unsigned int i = 0; i < 2; ++i){
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textures[i]);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, CSM_SIZE, CSM_SIZE, CSM_CASCADES, 0,
+                         GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[0], 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::SHADOW_FRAMEBUFFER incomplete" << std::endl;
+        GL_DEBUG_LABEL(GL_FRAMEBUFFER, fbo, "Shadow cascades");
+        GL_DEBUG_LABEL(GL_TEXTURE, textures[0], "Static shadow cascades");
+        GL_DEBUG_LABEL(GL_TEXTURE, textures[1], "Dynamic shadow cascades");
+        GpuMemory::tracker().texture(GPU_RENDER_TARGETS, textures[0], "Static shadow cascades", GL_DEPTH_COMPONENT24, CSM_SIZE, CSM_SIZE, CSM_CASCADES);
+        GpuMemory::tracker().texture(GPU_RENDER_TARGETS, textures[1], "Dynamic shadow cascades", GL_DEPTH_COMPONENT24, CSM_SIZE, CSM_SIZE, CSM_CASCADES);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        staticValid = false;
+        staticRenders = 0;
+    }
+
+    ~ShadowMaps(){
+        GpuMemory::tracker().release(GPU_TEXTURE, textures[0]);
+        GpuMemory::tracker().release(GPU_TEXTURE, textures[1]);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(2, textures);
+    }
+
+    // fits the cascades to the camera, returns true if the cached static layer has to be redrawn
+    bool update(const glm::vec3& lightDirection, const glm::mat4& view, float fovY, float aspect,
+                float zNear, unsigned int staticVersion){
+        bool unchanged = staticValid && lightDirection == cachedDirection && view == cachedView
+                         && fovY == cachedFovY && aspect == cachedAspect && staticVersion == cachedVersion;
+        if(unchanged)
+            return false;
+
+        cachedDirection = lightDirection;
+        cachedView = view;
+        cachedFovY = fovY;
+        cachedAspect = aspect;
+        cachedVersion = staticVersion;
+        fitCascades(glm::normalize(lightDirection), view, fovY, aspect, zNear);
+        return true;
+    }
+
+    void invalidate(){
+        staticValid = false;
+    }
+
+    // binds a cascade of one of the layers as the depth target and clears it
+    void beginCascade(bool staticLayer, unsigned int cascade){
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[staticLayer ? 0 : 1], 0, cascade);
+        glViewport(0, 0, CSM_SIZE, CSM_SIZE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // state shared by all shadow passes, depth clamping keeps casters in front of the light's near plane
+    void beginPass(){
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+    }
+
+    void endPass(unsigned int viewportWidth, unsigned int viewportHeight, bool staticLayer){
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, viewportWidth, viewportHeight);
+        if(staticLayer){
+            staticValid = true;
+            staticRenders++;
+        }
+    }
+
+    const glm::mat4& lightSpace(unsigned int cascade) const {
+        return lightSpaceMatrices[cascade];
+    }
+
+    // binds both layers and sets the uniforms the lighting shaders sample them with
+    void bind(const Shader& shader, bool enabled){
+        glActiveTexture(GL_TEXTURE0 + CSM_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textures[0]);
+        glActiveTexture(GL_TEXTURE0 + CSM_TEXTURE_UNIT + 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textures[1]);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setBool("shadowsEnabled", enabled);
+        shader.setInt("staticShadowMap", CSM_TEXTURE_UNIT);
+        shader.setInt("dynamicShadowMap", CSM_TEXTURE_UNIT + 1);
+        for(unsigned int i = 0; i < CSM_CASCADES; ++i){
+            std::string index = "[" + std::to_string(i) + "]";
+            shader.setMat4("lightSpaceMatrices" + index, lightSpaceMatrices[i]);
+            shader.setFloat("cascadeSplits" + index, cascadeSplits[i]);
+        }
+    }
+
+    unsigned int staticRenderCount() const {
+        return staticRenders;
+    }
+
+private:
+    unsigned int textures[2];
+    unsigned int fbo;
+
+    glm::mat4 lightSpaceMatrices[CSM_CASCADES];
+    float cascadeSplits[CSM_CASCADES];
+
+    bool staticValid;
+    unsigned int staticRenders;
+    glm::vec3 cachedDirection;
+    glm::mat4 cachedView;
+    float cachedFovY = 0.0f;
+    float cachedAspect = 0.0f;
+    unsigned int cachedVersion = 0;
+
+    void fitCascades(const glm::vec3& direction, const glm::mat4& view, float fovY, float aspect, float zNear){
+        glm::mat4 inverseView = glm::inverse(view);
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+        float splitNear = zNear;
+        for(unsigned int i = 0; i < CSM_CASCADES; ++i){
+            float fraction = (float)(i + 1) / CSM_CASCADES;
+            float logSplit = zNear * std::pow(CSM_MAX_DISTANCE / zNear, fraction);
+            float uniformSplit = zNear + (CSM_MAX_DISTANCE - zNear) * fraction;
+            float splitFar = CSM_SPLIT_LAMBDA * logSplit + (1.0f - CSM_SPLIT_LAMBDA) * uniformSplit;
+            cascadeSplits[i] = splitFar;
+
+            // bounding sphere of the slice of the view frustum keeps the cascade size stable under rotation
+            glm::vec3 corners[8];
+            glm::vec3 center(0.0f);
+            for(unsigned int c = 0; c < 8; ++c){
+                float distance = (c & 4) ? splitFar : splitNear;
+                float x = ((c & 1) ? 1.0f : -1.0f) * tanX * distance;
+                float y = ((c & 2) ? 1.0f : -1.0f) * tanY * distance;
+                corners[c] = glm::vec3(inverseView * glm::vec4(x, y, -distance, 1.0f));
+                center += corners[c];
+            }
+            center /= 8.0f;
+            float radius = 0.0f;
+            for(unsigned int c = 0; c < 8; ++c)
+                radius = std::max(radius, glm::length(corners[c] - center));
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            glm::mat4 lightView = glm::lookAt(center - direction * (radius + CSM_CASTER_PADDING), center, up);
+            glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f,
+                                                   2.0f * radius + CSM_CASTER_PADDING);
+            glm::mat4 lightSpace = lightProjection * lightView;
+
+            // snap the origin to whole texels so static shadows don't shimmer as the cascade moves
+            glm::vec4 origin = lightSpace * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            float texels = CSM_SIZE * 0.5f;
+            glm::vec4 offset((std::round(origin.x * texels) - origin.x * texels) / texels,
+                             (std::round(origin.y * texels) - origin.y * texels) / texels, 0.0f, 0.0f);
+            lightProjection[3] += offset;
+            lightSpaceMatrices[i] = lightProjection * lightView;
+
+            splitNear = splitFar;
+        }
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_SHADOWMAPS_HPP
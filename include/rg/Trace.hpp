@@ -0,0 +1,154 @@
+#ifndef MATF_RG_GAME_OMEGA_TRACE_HPP
+#define MATF_RG_GAME_OMEGA_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of named events on every thread, written in the Chrome trace_event JSON format so
+// it opens in chrome://tracing or Perfetto. Event names have to outlive the trace, string
+// literals are what they're meant for. Recording goes to a buffer per thread, the lock on it is
+// only ever contended while the file is being written.
+class Trace {
+public:
+    Trace() : origin(std::chrono::steady_clock::now()) {}
+
+    // the trace events are recorded into, null while tracing is off
+    static std::atomic<Trace*>& active(){
+        static std::atomic<Trace*> trace{nullptr};
+        return trace;
+    }
+
+    // shown as the thread's name in the viewer, can be set before tracing starts
+    static void setThreadName(const char* name){
+        threadName() = name;
+    }
+
+    // microseconds since the trace was created
+    double now() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void complete(const char* name, double start, double end){
+        ThreadEvents& events = threadEvents();
+        std::lock_guard<std::mutex> lock(events.mutex);
+        events.events.push_back({name, start, end - start});
+    }
+
+    bool write(const std::string& path){
+        std::ofstream file(path, std::ios::trunc);
+        if(!file){
+            std::cerr << "ERROR::TRACE could not write " << path << std::endl;
+            return false;
+        }
+        // microseconds with nanosecond digits, the default precision would round long traces and
+        // switch to exponents the viewers don't all read
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for(const std::unique_ptr<ThreadEvents>& thread : threads){
+            std::lock_guard<std::mutex> eventsLock(thread->mutex);
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+                 << ",\"args\":{\"name\":\"" << escape(thread->name) << "\"}}";
+            first = false;
+            for(const Event& event : thread->events){
+                file << ",\n{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id
+                     << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+            }
+        }
+        file << "\n]}\n";
+        return (bool)file;
+    }
+
+private:
+    struct Event {
+        const char* name;
+        double start;
+        double duration;
+    };
+
+    struct ThreadEvents {
+        unsigned int id;
+        std::string name;
+        std::mutex mutex;
+        std::vector<Event> events;
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+    static const char*& threadName(){
+        static thread_local const char* name = nullptr;
+        return name;
+    }
+
+    ThreadEvents& threadEvents(){
+        static thread_local ThreadEvents* cached = nullptr;
+        static thread_local Trace* owner = nullptr;
+        if(owner != this){
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            threads.emplace_back(new ThreadEvents());
+            cached = threads.back().get();
+            cached->id = threads.size();
+            cached->name = threadName() ? threadName() : "Thread " + std::to_string(cached->id);
+            owner = this;
+        }
+        return *cached;
+    }
+
+    static std::string escape(const std::string& text){
+        std::string escaped;
+        for(char c : text){
+            if(c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+};
+
+// begin and end nest per thread, an event is only kept if tracing was on when it began
+inline std::vector<std::pair<const char*, double>>& traceStack(){
+    static thread_local std::vector<std::pair<const char*, double>> stack;
+    return stack;
+}
+
+inline void traceBegin(const char* name){
+    Trace* trace = Trace::active().load(std::memory_order_acquire);
+    if(trace)
+        traceStack().push_back(std::make_pair(name, trace->now()));
+}
+
+inline void traceEnd(){
+    std::vector<std::pair<const char*, double>>& stack = traceStack();
+    if(stack.empty())
+        return;
+    Trace* trace = Trace::active().load(std::memory_order_acquire);
+    if(trace)
+        trace->complete(stack.back().first, stack.back().second, trace->now());
+    stack.pop_back();
+}
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name){
+        traceBegin(name);
+    }
+
+    ~TraceScope(){
+        traceEnd();
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif //MATF_RG_GAME_OMEGA_TRACE_HPP
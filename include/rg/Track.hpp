@@ -0,0 +1,150 @@
+#ifndef MATF_RG_GAME_OMEGA_TRACK_HPP
+#define MATF_RG_GAME_OMEGA_TRACK_HPP
+
+#include "rg/Random.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#define TRACK_CHUNKS 4
+// a chunk is two plane tiles long
+#define TRACK_CHUNK_LENGTH 4.0f
+#define TRACK_TILE_LENGTH 2.0f
+// a chunk whose far edge passes this z is behind the camera and gets recycled
+#define TRACK_RECYCLE_Z 3.0f
+// rows nearer than this are left empty when a run starts
+#define TRACK_FIRST_ROW_Z -10.0f
+// the normal game, the stress mode raises both
+#define TRACK_LANES 3
+#define TRACK_ROWS_PER_CHUNK 1
+#define TRACK_MAX_LANES 128
+#define TRACK_MAX_ROWS 64
+#define TRACK_LANE_WIDTH 0.66f
+// open lane of a row that has no obstacles
+#define TRACK_EMPTY_ROW 0xFF
+
+// Obstacles of a chunk, generated when the chunk is recycled to the back of the ring
+struct TrackChunk {
+    // z of the edge nearest to the player, the chunk spans [z - TRACK_CHUNK_LENGTH, z]
+    float z;
+    // every row blocks all lanes but its open one
+    uint8_t openLanes[TRACK_MAX_ROWS];
+    bool spawned;
+};
+
+// A fixed ring of track chunks scrolling towards the player. Chunks that fall behind the camera
+// are moved to the back of the ring with freshly generated obstacle rows, so a run of any
+// length keeps the same memory and per frame cost.
+class Track {
+public:
+    explicit Track(uint64_t seed, unsigned int lanes = TRACK_LANES, unsigned int rowsPerChunk = TRACK_ROWS_PER_CHUNK){
+        configure(lanes, rowsPerChunk);
+        reset(seed);
+    }
+
+    // takes effect with the next reset
+    void configure(unsigned int lanes, unsigned int rowsPerChunk){
+        laneCount = std::min(std::max(lanes, 2u), (unsigned int)TRACK_MAX_LANES);
+        rows = std::min(std::max(rowsPerChunk, 1u), (unsigned int)TRACK_MAX_ROWS);
+    }
+
+    // starts a new run, the same seed always lays out the same obstacles
+    void reset(uint64_t seed){
+        random.reseed(seed);
+        for(unsigned int i = 0; i < TRACK_CHUNKS; ++i){
+            chunks[i].z = TRACK_RECYCLE_Z - TRACK_CHUNK_LENGTH * i;
+            generateRows(chunks[i], true);
+        }
+        front = 0;
+        scrolled = 0.0;
+        layoutVersion++;
+    }
+
+    // moves the track by distance and calls spawn(lane, z) for every obstacle of rows not handed out yet
+    template<typename Spawn>
+    void scroll(float distance, Spawn spawn){
+        for(TrackChunk& chunk : chunks)
+            chunk.z += distance;
+        scrolled += distance;
+
+        // chunks are ordered front to back starting at front, only the front one can fall behind
+        while(chunks[front].z - TRACK_CHUNK_LENGTH > TRACK_RECYCLE_Z){
+            TrackChunk& last = chunks[(front + TRACK_CHUNKS - 1) % TRACK_CHUNKS];
+            TrackChunk& chunk = chunks[front];
+            chunk.z = last.z - TRACK_CHUNK_LENGTH;
+            generateRows(chunk, false);
+            front = (front + 1) % TRACK_CHUNKS;
+            layoutVersion++;
+        }
+
+        // in ring order, the lanes expect obstacles nearest first even when a long step recycled
+        // chunks on both sides of the array's end
+        for(unsigned int i = 0; i < TRACK_CHUNKS; ++i){
+            TrackChunk& chunk = chunks[(front + i) % TRACK_CHUNKS];
+            if(chunk.spawned)
+                continue;
+            for(unsigned int row = 0; row < rows; ++row){
+                if(chunk.openLanes[row] == TRACK_EMPTY_ROW)
+                    continue;
+                for(unsigned int lane = 0; lane < laneCount; ++lane)
+                    if(lane != chunk.openLanes[row])
+                        spawn(lane, rowZ(chunk, row));
+            }
+            chunk.spawned = true;
+        }
+    }
+
+    const TrackChunk& chunk(unsigned int i) const {
+        return chunks[i];
+    }
+
+    // total distance scrolled since the run started
+    double distance() const {
+        return scrolled;
+    }
+
+    // changes whenever chunks are recycled, for caches of the track geometry
+    unsigned int version() const {
+        return layoutVersion;
+    }
+
+    unsigned int lanes() const {
+        return laneCount;
+    }
+
+    unsigned int rowsPerChunk() const {
+        return rows;
+    }
+
+    float laneX(unsigned int lane) const {
+        return ((float)lane - (laneCount - 1) * 0.5f) * TRACK_LANE_WIDTH;
+    }
+
+    float width() const {
+        return laneCount * TRACK_LANE_WIDTH;
+    }
+
+private:
+    TrackChunk chunks[TRACK_CHUNKS];
+    unsigned int front;
+    double scrolled;
+    unsigned int layoutVersion = 0;
+    unsigned int laneCount;
+    unsigned int rows;
+    Random random;
+
+    float rowZ(const TrackChunk& chunk, unsigned int row) const {
+        return chunk.z - TRACK_CHUNK_LENGTH * (row + 0.5f) / rows;
+    }
+
+    // the open lane is drawn with a multiply-shift bound, so there is no retry loop for any lane count
+    void generateRows(TrackChunk& chunk, bool runStart){
+        for(unsigned int row = 0; row < rows; ++row){
+            bool empty = runStart && rowZ(chunk, row) > TRACK_FIRST_ROW_Z;
+            chunk.openLanes[row] = empty ? TRACK_EMPTY_ROW : (uint8_t)random.below(laneCount);
+        }
+        chunk.spawned = false;
+    }
+};
+
+#endif //MATF_RG_GAME_OMEGA_TRACK_HPP
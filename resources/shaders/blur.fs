@@ -7,11 +7,13 @@ in vec2 TexCoords;
 uniform sampler2D image;
 
 uniform bool horizontal;
+// a texel of the target, the first step reads a larger source and downsamples
+uniform vec2 texelSize;
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
 
 void main()
 {
-     vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
+     vec2 tex_offset = texelSize;
      vec3 result = texture(image, TexCoords).rgb * weight[0];
      if(horizontal)
      {
@@ -0,0 +1,18 @@
+#version 330 core
+
+out vec4 BrightColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+
+// the same threshold the forward shaders apply to their bright color output
+void main()
+{
+    vec3 result = texture(scene, TexCoords).rgb;
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 1.0)
+        BrightColor = vec4(result, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
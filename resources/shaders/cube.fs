@@ -49,6 +49,7 @@ in VS_OUT {
     vec3 Normal;
     vec2 TexCoord;
     vec4 WorldFragPos;
+    float ViewDepth;
 } fs_in;
 
 uniform vec3 viewPos;
@@ -57,18 +58,38 @@ uniform DirLight dirLight;
 uniform PointLight pointLight;
 uniform Material material;
 
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+uniform bool clusteredLighting;
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterScreenSize;
+uniform float clusterZScale;
+uniform float clusterZBias;
+
+uniform bool shadowsEnabled;
+uniform sampler2DArrayShadow staticShadowMap;
+uniform sampler2DArrayShadow dynamicShadowMap;
+uniform mat4 lightSpaceMatrices[3];
+uniform float cascadeSplits[3];
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+float calcShadow(vec3 fragPos, vec3 normal, vec3 lightDir, float viewDepth);
 vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 calcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir, float viewDepth);
 
 void main()
 {
     vec3 norm = normalize(fs_in.Normal);
     vec3 viewDir = normalize(viewPos - fs_in.WorldFragPos.xyz);
 
-    vec3 result = calcDirLight(dirLight, norm, viewDir);
+    float shadow = calcShadow(fs_in.WorldFragPos.xyz, norm, normalize(-dirLight.direction), fs_in.ViewDepth);
+    vec3 result = calcDirLight(dirLight, norm, viewDir, shadow);
     result += calcPointLight(pointLight, norm, fs_in.WorldFragPos.xyz, viewDir);
     result += calcSpotLight(spotLight, norm, fs_in.WorldFragPos.xyz, viewDir);
+    if(clusteredLighting)
+        result += calcClusterLights(norm, fs_in.WorldFragPos.xyz, viewDir, fs_in.ViewDepth);
 
     float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
     if(brightness > 1.0)
@@ -79,7 +100,7 @@ void main()
     FragColor = vec4(result, 0.8);
 }
 
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     //diffuse
@@ -91,7 +112,7 @@ vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, fs_in.TexCoord));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fs_in.TexCoord));
     vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoord));
-    return (ambient + diffuse + specular);
+    return (ambient + (1.0 - shadow) * (diffuse + specular));
 }
 
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -142,4 +163,78 @@ vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     specular *= attenuation * intensity;
 
     return (ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+
+vec3 calcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir, float viewDepth)
+{
+    //find the froxel this fragment lies in
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterScreenSize * vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+    int slice = clamp(int(log(viewDepth) * clusterZScale - clusterZBias), 0, clusterDims.z - 1);
+    int cluster = tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+    uvec2 range = texelFetch(clusterGrid, cluster).rg;
+
+    vec3 albedo = vec3(texture(material.diffuse, fs_in.TexCoord));
+    vec3 specularMap = vec3(texture(material.specular, fs_in.TexCoord));
+    vec3 result = vec3(0.0);
+    for(uint i = 0u; i < range.y; ++i)
+    {
+        int light = int(texelFetch(clusterIndices, int(range.x + i)).r) * 5;
+        vec4 positionRadius = texelFetch(clusterLights, light);
+        vec4 diffuseSpot = texelFetch(clusterLights, light + 1);
+        vec4 specularConstant = texelFetch(clusterLights, light + 2);
+        vec4 directionCutOff = texelFetch(clusterLights, light + 3);
+        vec4 attenuationOuterCutOff = texelFetch(clusterLights, light + 4);
+
+        float distance = length(positionRadius.xyz - fragPos);
+        if(distance >= positionRadius.w)
+            continue;
+        vec3 lightDir = (positionRadius.xyz - fragPos) / distance;
+        //diffuse
+        float diff = max(dot(normal, lightDir), 0.0);
+        //specular
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+        //attenuation, windowed so the light fades out exactly at the radius it was binned with
+        float attenuation = 1.0 / (specularConstant.w + attenuationOuterCutOff.x * distance + attenuationOuterCutOff.y * distance * distance);
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+        if(diffuseSpot.w > 0.5)
+        {
+            float theta = dot(lightDir, normalize(-directionCutOff.xyz));
+            float epsilon = directionCutOff.w - attenuationOuterCutOff.z;
+            attenuation *= clamp((theta - attenuationOuterCutOff.z)/epsilon, 0.0, 1.0);
+        }
+
+        vec3 diffuse = diffuseSpot.rgb * diff * albedo;
+        vec3 specular = specularConstant.rgb * spec * specularMap;
+        result += (diffuse + specular) * attenuation;
+    }
+    return result;
+}
+
+float calcShadow(vec3 fragPos, vec3 normal, vec3 lightDir, float viewDepth)
+{
+    if(!shadowsEnabled || viewDepth > cascadeSplits[2])
+        return 0.0;
+    int cascade = viewDepth > cascadeSplits[0] ? (viewDepth > cascadeSplits[1] ? 2 : 1) : 0;
+
+    //push the lookup along the normal, more so on surfaces facing away from the light
+    float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec4 lightSpace = lightSpaceMatrices[cascade] * vec4(fragPos + normal * (0.01 + 0.02 * slope) * float(cascade + 1), 1.0);
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    if(coords.z > 1.0)
+        return 0.0;
+
+    //2x2 PCF on the hardware comparison, a texel is occluded by the nearer of the two layers
+    vec2 texelSize = 1.0 / vec2(textureSize(staticShadowMap, 0).xy);
+    float lit = 0.0;
+    for(int x = 0; x < 2; ++x)
+    {
+        for(int y = 0; y < 2; ++y)
+        {
+            vec4 lookup = vec4(coords.xy + (vec2(x, y) - 0.5) * texelSize, float(cascade), coords.z);
+            lit += min(texture(staticShadowMap, lookup), texture(dynamicShadowMap, lookup));
+        }
+    }
+    return 1.0 - lit / 4.0;
+}
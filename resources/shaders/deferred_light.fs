@@ -0,0 +1,137 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+struct Light {
+    vec3 position;
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float cutOff;
+    float outerCutOff;
+
+    float radius;
+    bool windowed;
+};
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform mat4 view;
+uniform vec3 viewPos;
+
+uniform bool shadowsEnabled;
+uniform sampler2DArrayShadow staticShadowMap;
+uniform sampler2DArrayShadow dynamicShadowMap;
+uniform mat4 lightSpaceMatrices[3];
+uniform float cascadeSplits[3];
+
+//0 - directional, 1 - point, 2 - spot
+uniform int lightType;
+uniform Light light;
+
+float calcShadow(vec3 fragPos, vec3 normal, vec3 lightDir, float viewDepth);
+
+vec3 decodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    //nothing was drawn here, the background keeps the clear color
+    if(depth == 1.0)
+        discard;
+
+    vec4 albedoSpecular = texture(gAlbedoSpecular, TexCoords);
+    vec4 normalShininess = texture(gNormalShininess, TexCoords);
+    vec3 normal = decodeNormal(normalShininess.xy);
+    float shininess = normalShininess.z * 256.0;
+
+    vec4 world = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 lightDir;
+    float attenuation = 1.0;
+    float shadow = 0.0;
+    if(lightType == 0)
+    {
+        lightDir = normalize(-light.direction);
+        shadow = calcShadow(fragPos, normal, lightDir, -(view * vec4(fragPos, 1.0)).z);
+    }
+    else
+    {
+        float distance = length(light.position - fragPos);
+        if(light.windowed && distance >= light.radius)
+            discard;
+        lightDir = (light.position - fragPos) / distance;
+        attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+        if(light.windowed)
+        {
+            float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+            attenuation *= window * window;
+        }
+        if(lightType == 2)
+        {
+            float theta = dot(lightDir, normalize(-light.direction));
+            float epsilon = light.cutOff - light.outerCutOff;
+            attenuation *= clamp((theta - light.outerCutOff)/epsilon, 0.0, 1.0);
+        }
+    }
+    //diffuse
+    float diff = max(dot(normal, lightDir), 0.0);
+    //specular
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+
+    vec3 ambient = light.ambient * albedoSpecular.rgb;
+    vec3 diffuse = light.diffuse * diff * albedoSpecular.rgb;
+    vec3 specular = light.specular * spec * albedoSpecular.a;
+
+    FragColor = vec4((ambient + (1.0 - shadow) * (diffuse + specular)) * attenuation, 1.0);
+}
+
+float calcShadow(vec3 fragPos, vec3 normal, vec3 lightDir, float viewDepth)
+{
+    if(!shadowsEnabled || viewDepth > cascadeSplits[2])
+        return 0.0;
+    int cascade = viewDepth > cascadeSplits[0] ? (viewDepth > cascadeSplits[1] ? 2 : 1) : 0;
+
+    //push the lookup along the normal, more so on surfaces facing away from the light
+    float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec4 lightSpace = lightSpaceMatrices[cascade] * vec4(fragPos + normal * (0.01 + 0.02 * slope) * float(cascade + 1), 1.0);
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    if(coords.z > 1.0)
+        return 0.0;
+
+    //2x2 PCF on the hardware comparison, a texel is occluded by the nearer of the two layers
+    vec2 texelSize = 1.0 / vec2(textureSize(staticShadowMap, 0).xy);
+    float lit = 0.0;
+    for(int x = 0; x < 2; ++x)
+    {
+        for(int y = 0; y < 2; ++y)
+        {
+            vec4 lookup = vec4(coords.xy + (vec2(x, y) - 0.5) * texelSize, float(cascade), coords.z);
+            lit += min(texture(staticShadowMap, lookup), texture(dynamicShadowMap, lookup));
+        }
+    }
+    return 1.0 - lit / 4.0;
+}
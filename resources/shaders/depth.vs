@@ -0,0 +1,16 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+//must produce bit identical depth to the lit programs for the GL_EQUAL main pass
+invariant gl_Position;
+
+void main()
+{
+    vec4 worldFragPos = model * normalize(vec4(aPos, 1.0));
+    gl_Position = projection * view * worldFragPos;
+}
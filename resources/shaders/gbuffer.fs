@@ -0,0 +1,36 @@
+#version 330 core
+
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalShininess;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in VS_OUT {
+    vec3 Normal;
+    vec2 TexCoord;
+    vec4 WorldFragPos;
+    float ViewDepth;
+} fs_in;
+
+uniform Material material;
+
+//octahedral mapping of a unit vector into [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    vec2 folded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+    return folded * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec3 albedo = vec3(texture(material.diffuse, fs_in.TexCoord));
+    float specular = dot(vec3(texture(material.specular, fs_in.TexCoord)), vec3(1.0 / 3.0));
+    gAlbedoSpecular = vec4(albedo, specular);
+    gNormalShininess = vec4(encodeNormal(normalize(fs_in.Normal)), clamp(material.shininess / 256.0, 0.0, 1.0), 1.0);
+}
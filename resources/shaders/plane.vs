@@ -8,16 +8,20 @@ out VS_OUT {
     vec3 Normal;
     vec2 TexCoord;
     vec4 WorldFragPos;
+    float ViewDepth;
 } vs_out;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+invariant gl_Position;
+
 void main()
 {
     vs_out.Normal = aNormal;
     vs_out.TexCoord = aTexCoord;
     vs_out.WorldFragPos = model * normalize(vec4(aPos, 1.0));
+    vs_out.ViewDepth = -(view * vs_out.WorldFragPos).z;
     gl_Position = projection * view * vs_out.WorldFragPos;
 }
\ No newline at end of file
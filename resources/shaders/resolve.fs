@@ -0,0 +1,26 @@
+#version 330 core
+
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+uniform sampler2DMS scene;
+uniform sampler2DMS bright;
+uniform int samples;
+uniform bool bloom;
+
+// averages the samples of both attachments, the bright color was already thresholded per sample
+// by the scene shaders. Without bloom nothing is attached to the second output.
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec3 color = vec3(0.0);
+    vec3 brightColor = vec3(0.0);
+    for(int i = 0; i < samples; ++i)
+    {
+        color += texelFetch(scene, texel, i).rgb;
+        if(bloom)
+            brightColor += texelFetch(bright, texel, i).rgb;
+    }
+    FragColor = vec4(color / float(samples), 1.0);
+    BrightColor = vec4(brightColor / float(samples), 1.0);
+}
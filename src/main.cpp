@@ -2,6 +2,29 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "rg/Cube.hpp"
+#include "rg/Lights.hpp"
+#include "rg/LightCluster.hpp"
+#include "rg/DeferredRenderer.hpp"
+#include "rg/Profiler.hpp"
+#include "rg/ShadowMaps.hpp"
+#include "rg/Track.hpp"
+#include "rg/Random.hpp"
+#include "rg/Replay.hpp"
+#include "rg/Collision.hpp"
+#include "rg/Frustum.hpp"
+#include "rg/FramePipeline.hpp"
+#include "rg/JobSystem.hpp"
+#include "rg/ObjLoader.hpp"
+#include "rg/AssetPack.hpp"
+#include "rg/Trace.hpp"
+#include "rg/FrameLimiter.hpp"
+#include "rg/AutoSave.hpp"
+#include "rg/Settings.hpp"
+#include "rg/GLDebug.hpp"
+#include "rg/GpuMemory.hpp"
+#include "rg/RenderGraph.hpp"
+#include "rg/RenderFormats.hpp"
+#include "rg/FormatBenchmark.hpp"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -16,10 +39,37 @@
 #include <learnopengl/model.h>
 
 #include <iostream>
-#include <unordered_set>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <sstream>
 
 #define CUBE_VELOCITY 2.5f
-#define CUBE_Z_SPAWN_FACTOR -6.0f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100.0f
+#define TRACK_LIGHT_SPACING 1.5f
+// bounding sphere radii used for frustum culling
+#define CUBE_RADIUS 0.35f
+#define GAZELLE_RADIUS 0.6f
+#define STRESS_MAX_GAZELLES 8192
+// frustum tests per culling job
+#define CULL_OBJECTS_PER_JOB 1024
+// gaussian blur passes over the bloom, alternating horizontal and vertical
+#define BLOOM_BLUR_STEPS 10
+// the blur runs at this fraction of the screen, its first step samples the full size bright color
+#define BLOOM_DOWNSAMPLE 2
+// made with tools/asset_packer, loose files under resources/ are used when it is missing
+#define ASSET_PACK_PATH "resources.pack"
+#define PROGRAM_STATE_PATH "resources/program_state.bin"
+// positional text file of older versions, read once when there is no binary one yet
+#define LEGACY_PROGRAM_STATE_PATH "resources/program_state.txt"
+// settings changes reach the disk at most this often
+#define AUTOSAVE_INTERVAL 2.0
+// without input the overlay is rebuilt this often so the numbers it shows stay current
+#define UI_REFRESH_INTERVAL 0.25
+// frames rebuilt after an input, clicks and releases take ImGui a frame to settle
+#define UI_SETTLE_FRAMES 2
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -31,20 +81,76 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(char const* path, bool gammaCorrection);
+void ui_mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
 
-void drawImGui();
+void ui_scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+
+void ui_char_callback(GLFWwindow *window, unsigned int codepoint);
+
+bool uiNeedsRebuild(GLFWwindow *window);
+
+void setCursorVisible(GLFWwindow *window, bool visible);
+
+// pixels straight from stb_image, decoding touches no GL so it can run on any thread
+struct DecodedImage {
+    unsigned char* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+DecodedImage decodeImage(char const* path, bool flipVertically);
+
+unsigned int uploadTexture(DecodedImage& image, bool gammaCorrection, const char* name);
+
+struct RenderSnapshot;
+
+void drawImGui(const RenderSnapshot& snapshot);
 
 void setUpShaderLights(Shader shader);
 
 void setMaterialAttributes(Shader shader, float shininess);
 
-int comparableFloat(float val);
 
 void resetGame();
 
+uint64_t nextRunSeed();
+
+struct StressSettings;
+
+void applyStressSettings(const StressSettings& settings);
+
+void updateGame(float dt);
+
+void applyGameInput(ReplayEvent event);
+
+void postGameInput(ReplayEvent event, double time = 0.0);
+
+struct SimCommand;
+
+void postSimCommand(const SimCommand& command);
+
+void runSimulation();
+
+void writeSnapshot(RenderSnapshot& snapshot, int trackLights, float simulationMs);
+
+int runHeadlessReplay();
+
+const char* argValue(int argc, char** argv, const char* name);
+
+bool hasArg(int argc, char** argv, const char* name);
+
 void renderQuad();
 
+void buildTrackLights(std::vector<ClusteredLight>& lights, int count);
+
+// what a scene draw feeds the programs with
+enum ScenePass {
+    SCENE_PASS_LIT,
+    SCENE_PASS_GBUFFER,
+    SCENE_PASS_DEPTH
+};
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -60,47 +166,101 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 
-float xModelPos = 0.0f;
+// lane index of the model, 0 is the leftmost lane
+unsigned int playerLane = TRACK_LANES / 2;
 bool collided = false;
 
-struct SpotLight {
-    glm::vec3 position;
-    glm::vec3 direction;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    float cutOff;
-    float outerCutOff;
+// obstacle load of a run, the defaults are the normal game
+struct StressSettings {
+    int lanes = TRACK_LANES;
+    int rowsPerChunk = TRACK_ROWS_PER_CHUNK;
+    float speed = CUBE_VELOCITY;
+    // drawn next to the track, they only load culling and rendering
+    int extraGazelles = 0;
+
+    static StressSettings preset(){
+        StressSettings settings;
+        settings.lanes = 64;
+        settings.rowsPerChunk = 32;
+        settings.extraGazelles = 256;
+        return settings;
+    }
 };
-
-struct PointLight {
-    glm::vec3 position;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
+StressSettings stress;
+// edited in ImGui, applied when the run is restarted
+StressSettings stressPending;
+
+// what the simulation is told to do, in the order the main thread issued it
+enum SimCommandType {
+    SIM_TICK,
+    SIM_INPUT,
+    SIM_APPLY_STRESS
+};
+struct SimCommand {
+    SimCommandType type;
+    float deltaTime;
+    int trackLights;
+    ReplayEvent event;
+    // glfwGetTime() when a key press was received, 0 for inputs that came from a replay
+    double inputTime;
+    StressSettings stress;
 };
 
-//global light
-struct DirLight {
-    glm::vec3 direction;
-
-    glm::vec3 ambient;
-    glm::vec3 specular;
-    glm::vec3 diffuse;
+// everything the renderer reads of the game, written by the simulation once per tick
+struct RenderSnapshot {
+    std::vector<glm::vec3> obstacles;
+    std::vector<ClusteredLight> trackLights;
+    float chunkZ[TRACK_CHUNKS];
+    unsigned int trackVersion = 0;
+    float trackWidth = TRACK_LANES * TRACK_LANE_WIDTH;
+    glm::vec3 player;
+    int extraGazelles = 0;
+    unsigned int score = 0;
+    unsigned int highScore = 0;
+    uint64_t runSeed = 0;
+    float simulationMs = 0.0f;
+    // key presses applied so far and the time of the newest, for input to swap latency
+    unsigned int inputCount = 0;
+    double inputTime = 0.0;
 };
 
+// The main thread only posts commands and reads snapshots. With pipelining on, the worker owns
+// the game state and simulates frame N+1 while the main thread submits frame N.
+SpscQueue<SimCommand, 1024> simCommands;
+TripleBuffer<RenderSnapshot> snapshots;
+PipelineWorker simWorker;
+JobSystem *jobs;
+AssetPack assetPack;
+// startup is traced up to the end of the first frame when --trace is given
+Trace startupTrace;
+const char* tracePath = nullptr;
+FrameLimiter frameLimiter;
+AutoSave autosave;
+
+// The overlay keeps drawing the draw data of its last rebuild until input arrives or the refresh
+// interval runs out, rebuilding runs NewFrame and every window.
+struct RetainedUi {
+    // bumped by the input callbacks
+    unsigned int inputSerial = 0;
+    unsigned int builtSerial = 0;
+    // below zero the draw data is stale
+    double builtAt = -1.0;
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    int settleFrames = 0;
+    bool cursorVisible = false;
+    unsigned int rebuilds = 0;
+};
+RetainedUi ui;
+// owned by the simulation like the rest of the game state, the high score is copied back into
+// the program state by the main thread
+unsigned int gameScore = 0;
+unsigned int gameHighScore = 0;
+unsigned int appliedInputs = 0;
+double appliedInputTime = 0.0;
 
+unsigned int visibleObstacles = 0;
+unsigned int visibleGazelles = 0;
 
 struct ProgramState {
 
@@ -113,7 +273,20 @@ struct ProgramState {
         quadVAO = -1;
         cubeShininess = 32.0;
         planeShininess = 32.0;
-        score = 0;
+        clusteredLighting = true;
+        trackLightCount = 24;
+        deferredShading = false;
+        depthPrePass = false;
+        shadows = true;
+        shadowCache = true;
+        seed = 0;
+        pipelinedSimulation = true;
+        vsyncMode = VSYNC_ON;
+        fpsLimit = 0;
+        idleThrottle = true;
+        gpuBudgetMB = 512;
+        sceneFormat = FORMAT_R11G11B10F;
+        bloomFormat = FORMAT_R11G11B10F;
     }
     glm::vec3 clearColor;
     bool ImGuiEnabled;
@@ -129,67 +302,121 @@ struct ProgramState {
     float cubeShininess;
     float planeShininess;
     bool loadSaved;
-    unsigned int score;
     unsigned int highScore;
+    bool clusteredLighting;
+    int trackLightCount;
+    bool deferredShading;
+    bool depthPrePass;
+    bool shadows;
+    bool shadowCache;
+    // seed of the obstacle generator, 0 picks a new one every session
+    unsigned long long seed;
+    bool pipelinedSimulation;
+    int vsyncMode;
+    // 0 leaves the frame rate to vsync
+    int fpsLimit;
+    // drops to FRAME_LIMITER_IDLE_FPS while the window is in the background
+    bool idleThrottle;
+    // video memory the renderer's allocations are warned against
+    int gpuBudgetMB;
+    // RenderFormat of the HDR scene targets and of the bloom, unrenderable ones fall back to RGBA16F
+    int sceneFormat;
+    int bloomFormat;
+    // bumped on every change, not saved
+    unsigned int revision = 0;
+
+    void changed() {
+        revision++;
+    }
+
+    // binds every saved field to its tag, see rg/Settings.hpp
+    void describe(SettingsSchema& schema);
+
+    std::string serialize() const;
+
+    std::string exportText() const;
 
-    void SaveToFile(std::string filename);
+    // false if there is no settings file, fields missing from it keep their defaults
+    bool LoadFromFile(std::string filename);
 
-    void LoadFromFile(std::string filename);
+    void LoadLegacyFile(std::string filename);
 
     void setUpLights();
 };
 
-void ProgramState::SaveToFile(std::string filename) {
-    std::ofstream out(filename);
-    out << clearColor.r << '\n'
-        << clearColor.g << '\n'
-        << clearColor.b << '\n'
-        << ImGuiEnabled << '\n'
-        << spotLight.position.x << '\n'
-        << spotLight.position.y << '\n'
-        << spotLight.position.z << '\n'
-        << spotLight.direction.x << '\n'
-        << spotLight.direction.y << '\n'
-        << spotLight.direction.z << '\n'
-        << spotLight.ambient.x << '\n'
-        << spotLight.ambient.y << '\n'
-        << spotLight.ambient.z << '\n'
-        << spotLight.diffuse.x << '\n'
-        << spotLight.diffuse.y << '\n'
-        << spotLight.diffuse.z << '\n'
-        << spotLight.specular.x << '\n'
-        << spotLight.specular.y << '\n'
-        << spotLight.specular.z << '\n'
-        << pointLight.position.x << '\n'
-        << pointLight.position.y << '\n'
-        << pointLight.position.z << '\n'
-        << pointLight.ambient.x << '\n'
-        << pointLight.ambient.y << '\n'
-        << pointLight.ambient.z << '\n'
-        << pointLight.diffuse.x << '\n'
-        << pointLight.diffuse.y << '\n'
-        << pointLight.diffuse.z << '\n'
-        << pointLight.specular.x << '\n'
-        << pointLight.specular.y << '\n'
-        << pointLight.specular.z << '\n'
-        << dirLight.direction.x << '\n'
-        << dirLight.direction.y << '\n'
-        << dirLight.direction.z << '\n'
-        << dirLight.ambient.x << '\n'
-        << dirLight.ambient.y << '\n'
-        << dirLight.ambient.z << '\n'
-        << dirLight.diffuse.x << '\n'
-        << dirLight.diffuse.y << '\n'
-        << dirLight.diffuse.z << '\n'
-        << dirLight.specular.x << '\n'
-        << dirLight.specular.y << '\n'
-        << dirLight.specular.z << '\n'
-        << exposure << '\n'
-        << sampleNum << '\n'
-        << highScore;
-}
-
-void ProgramState::LoadFromFile(std::string filename) {
+void ProgramState::describe(SettingsSchema& schema) {
+    schema.field(1, "clear_color", clearColor);
+    schema.field(2, "imgui_enabled", ImGuiEnabled);
+    schema.field(3, "spot_light.position", spotLight.position);
+    schema.field(4, "spot_light.direction", spotLight.direction);
+    schema.field(5, "spot_light.ambient", spotLight.ambient);
+    schema.field(6, "spot_light.diffuse", spotLight.diffuse);
+    schema.field(7, "spot_light.specular", spotLight.specular);
+    schema.field(8, "point_light.position", pointLight.position);
+    schema.field(9, "point_light.ambient", pointLight.ambient);
+    schema.field(10, "point_light.diffuse", pointLight.diffuse);
+    schema.field(11, "point_light.specular", pointLight.specular);
+    schema.field(12, "dir_light.direction", dirLight.direction);
+    schema.field(13, "dir_light.ambient", dirLight.ambient);
+    schema.field(14, "dir_light.diffuse", dirLight.diffuse);
+    schema.field(15, "dir_light.specular", dirLight.specular);
+    schema.field(16, "exposure", exposure);
+    schema.field(17, "sample_count", sampleNum);
+    schema.field(18, "high_score", highScore);
+    schema.field(19, "clustered_lighting", clusteredLighting);
+    schema.field(20, "track_light_count", trackLightCount);
+    schema.field(21, "deferred_shading", deferredShading);
+    schema.field(22, "depth_pre_pass", depthPrePass);
+    schema.field(23, "shadows", shadows);
+    schema.field(24, "shadow_cache", shadowCache);
+    schema.field(25, "seed", seed);
+    schema.field(26, "pipelined_simulation", pipelinedSimulation);
+    schema.field(27, "vsync_mode", vsyncMode);
+    schema.field(28, "fps_limit", fpsLimit);
+    schema.field(29, "idle_throttle", idleThrottle);
+    // not in the legacy text file
+    schema.field(30, "cube_shininess", cubeShininess);
+    schema.field(31, "plane_shininess", planeShininess);
+    schema.field(32, "spot_light.constant", spotLight.constant);
+    schema.field(33, "spot_light.linear", spotLight.linear);
+    schema.field(34, "spot_light.quadratic", spotLight.quadratic);
+    schema.field(35, "point_light.constant", pointLight.constant);
+    schema.field(36, "point_light.linear", pointLight.linear);
+    schema.field(37, "point_light.quadratic", pointLight.quadratic);
+    schema.field(38, "gpu_budget_mb", gpuBudgetMB);
+    schema.field(39, "scene_format", sceneFormat);
+    schema.field(40, "bloom_format", bloomFormat);
+}
+
+// the schema points at fields to read and write them, a copy keeps this usable on const states
+std::string ProgramState::serialize() const {
+    ProgramState state = *this;
+    SettingsSchema schema;
+    state.describe(schema);
+    return schema.encode();
+}
+
+std::string ProgramState::exportText() const {
+    ProgramState state = *this;
+    SettingsSchema schema;
+    state.describe(schema);
+    return schema.exportText();
+}
+
+bool ProgramState::LoadFromFile(std::string filename) {
+    MappedFile file;
+    if(!file.open(filename))
+        return false;
+    SettingsSchema schema;
+    describe(schema);
+    if(!schema.decode(file.data(), file.size())){
+        std::cerr << "ERROR::SETTINGS " << filename << " is not a settings file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ProgramState::LoadLegacyFile(std::string filename) {
     std::ifstream in(filename);
     if (in) {
         in >> clearColor.r
@@ -237,7 +464,18 @@ void ProgramState::LoadFromFile(std::string filename) {
            >> dirLight.specular.z
            >> exposure
            >> sampleNum
-           >> highScore;
+           >> highScore
+           >> clusteredLighting
+           >> trackLightCount
+           >> deferredShading
+           >> depthPrePass
+           >> shadows
+           >> shadowCache
+           >> seed
+           >> pipelinedSimulation
+           >> vsyncMode
+           >> fpsLimit
+           >> idleThrottle;
     }
 }
 
@@ -270,18 +508,127 @@ void ProgramState::setUpLights()
 }
 
 ProgramState *programState;
-std::unordered_set<Cube* > cubes;
+ObstacleLanes obstacles;
+LightCluster *lightCluster;
+Profiler *profiler;
+ShadowMaps *shadowMaps;
+RenderGraph *renderGraph;
+RenderFormats renderFormats;
+// samples the MSAA targets were created with, a changed setting applies after a restart
+int msaaSamples = 0;
+Track *track;
+// every run of the session gets its obstacle seed from here, so the session seed reproduces all runs
+Random sessionRandom;
+uint64_t sessionSeed;
+uint64_t runSeed;
+// at most one of them is set, a replay being played back ignores the game keys
+ReplayRecorder *recorder = nullptr;
+ReplayPlayer *player = nullptr;
 
 DirLight dirLight;
 SpotLight spotLight;
 
-int main() {
+int main(int argc, char** argv) {
+    tracePath = argValue(argc, argv, "--trace");
+    if(tracePath)
+        Trace::active() = &startupTrace;
+    Trace::setThreadName("Main");
+    traceBegin("Startup");
+    traceBegin("Job system");
+    jobs = new JobSystem();
+    traceEnd();
+    traceBegin("Asset pack");
+    const char* packPath = argValue(argc, argv, "--pack") ? argValue(argc, argv, "--pack") : ASSET_PACK_PATH;
+    if(assetPack.open(packPath))
+        AssetPack::mounted() = &assetPack;
+    else if(argValue(argc, argv, "--pack"))
+        std::cerr << "ERROR::ASSET_PACK could not open " << packPath << std::endl;
+    traceEnd();
+    traceBegin("Settings");
+    programState = new ProgramState();
+    // an old text file is migrated, the changed revision makes the first frame save it in the new format
+    if(!programState->LoadFromFile(PROGRAM_STATE_PATH) && access(LEGACY_PROGRAM_STATE_PATH, R_OK) == 0){
+        programState->LoadLegacyFile(LEGACY_PROGRAM_STATE_PATH);
+        programState->changed();
+    }
+    // only exports, the game doesn't start
+    if(argValue(argc, argv, "--export-settings")){
+        std::ofstream out(argValue(argc, argv, "--export-settings"));
+        out << programState->exportText();
+        bool written = (bool)out;
+        if(!written)
+            std::cerr << "ERROR::SETTINGS could not write " << argValue(argc, argv, "--export-settings") << std::endl;
+        delete programState;
+        delete jobs;
+        return written ? 0 : 1;
+    }
+    gameHighScore = programState->highScore;
+    traceEnd();
+
+    // --seed on the command line wins over the saved one
+    sessionSeed = programState->seed;
+    if(argValue(argc, argv, "--seed"))
+        sessionSeed = std::strtoull(argValue(argc, argv, "--seed"), nullptr, 10);
+    if(sessionSeed == 0)
+        sessionSeed = ((uint64_t)std::random_device()() << 32u) | std::random_device()();
+    // a replay brings its own session seed
+    if(argValue(argc, argv, "--replay")){
+        player = new ReplayPlayer();
+        if(!player->open(argValue(argc, argv, "--replay")))
+            return -1;
+        sessionSeed = player->seed();
+    }
+    // --stress starts from a heavy preset, the other options override single values
+    if(hasArg(argc, argv, "--stress"))
+        stress = StressSettings::preset();
+    if(argValue(argc, argv, "--lanes"))
+        stress.lanes = std::atoi(argValue(argc, argv, "--lanes"));
+    if(argValue(argc, argv, "--rows"))
+        stress.rowsPerChunk = std::atoi(argValue(argc, argv, "--rows"));
+    if(argValue(argc, argv, "--speed")){
+        float speed = (float)std::atof(argValue(argc, argv, "--speed"));
+        if(std::isfinite(speed) && speed > 0.0f)
+            stress.speed = speed;
+        else
+            std::cerr << "ERROR::ARGUMENTS --speed has to be a positive number, got " << argValue(argc, argv, "--speed") << std::endl;
+    }
+    if(argValue(argc, argv, "--gazelles"))
+        stress.extraGazelles = std::min(std::max(std::atoi(argValue(argc, argv, "--gazelles")), 0), STRESS_MAX_GAZELLES);
+    if(player){
+        stress.lanes = player->lanes();
+        stress.rowsPerChunk = player->rowsPerChunk();
+        stress.speed = player->speed();
+    }
+    sessionRandom.reseed(sessionSeed);
+    runSeed = nextRunSeed();
+    track = new Track(runSeed, stress.lanes, stress.rowsPerChunk);
+    // the track clamps the counts to what it supports
+    stress.lanes = track->lanes();
+    stress.rowsPerChunk = track->rowsPerChunk();
+    stressPending = stress;
+    obstacles.setLanes(track->lanes());
+    playerLane = track->lanes() / 2;
+    if(player && hasArg(argc, argv, "--headless"))
+        return runHeadlessReplay();
+    if(!player && argValue(argc, argv, "--record")){
+        recorder = new ReplayRecorder();
+        if(!recorder->open(argValue(argc, argv, "--record"), sessionSeed, track->lanes(), track->rowsPerChunk(), stress.speed)){
+            delete recorder;
+            recorder = nullptr;
+        }
+    }
+
     // glfw: initialize and configure
     // ------------------------------
+    traceBegin("glfwInit");
     glfwInit();
+    traceEnd();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if RG_GL_DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -289,6 +636,7 @@ int main() {
 
     // glfw window creation
     // --------------------
+    traceBegin("Create window");
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "matf_rg_game_omega", NULL, NULL);
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -296,24 +644,34 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    traceEnd();
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetKeyCallback(window, key_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    // ImGui installs its own callbacks later and chains to these
+    glfwSetMouseButtonCallback(window, ui_mouse_button_callback);
+    glfwSetScrollCallback(window, ui_scroll_callback);
+    glfwSetCharCallback(window, ui_char_callback);
     // glad: load all OpenGL function pointers
     // ---------------------------------------
+    traceBegin("gladLoadGLLoader");
     if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-
-    programState = new ProgramState();
-    programState->LoadFromFile("resources/program_state.txt");
-
-    if (programState->ImGuiEnabled) {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-    }
+    traceEnd();
+    GL_DEBUG_INSTALL();
+    GpuMemory::tracker().setBudget((uint64_t)programState->gpuBudgetMB * 1024 * 1024);
+    RenderStats renderStats;
+    RenderStats::installHooks();
+    RenderStats::active() = &renderStats;
+    if(argValue(argc, argv, "--render-stats"))
+        renderStats.openCsv(argValue(argc, argv, "--render-stats"));
+
+    setCursorVisible(window, programState->ImGuiEnabled);
     // Init Imgui
+    traceBegin("ImGui init");
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO &io = ImGui::GetIO();
@@ -321,17 +679,46 @@ int main() {
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
+    traceEnd();
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    traceBegin("Compile shaders");
     Shader planeShader("resources/shaders/plane.vs", "resources/shaders/plane.fs");
     Shader cubeShader("resources/shaders/cube.vs", "resources/shaders/cube.fs");
     Shader modelShader("resources/shaders/model.vs", "resources/shaders/model.fs");
     Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
     Shader screenShader("resources/shaders/screen.vs", "resources/shaders/screen.fs");
-
-    Model objectModel("resources/objects/gazelle_model/10020_Gazelle_v04.obj");
+    Shader resolveShader("resources/shaders/screen.vs", "resources/shaders/resolve.fs");
+    Shader brightShader("resources/shaders/screen.vs", "resources/shaders/bright.fs");
+    Shader depthShader("resources/shaders/depth.vs", "resources/shaders/depth.fs");
+    Shader gBufferPlaneShader("resources/shaders/plane.vs", "resources/shaders/gbuffer.fs");
+    Shader gBufferCubeShader("resources/shaders/cube.vs", "resources/shaders/gbuffer.fs");
+    Shader gBufferModelShader("resources/shaders/model.vs", "resources/shaders/gbuffer.fs");
+    traceEnd();
+
+    // textures are decoded on the job system while the model is imported, uploads stay on this thread
+    const char* texturePaths[] = {
+            "resources/textures/plane.JPG",
+            "resources/textures/container.png",
+            "resources/textures/container_specular.png"
+    };
+    DecodedImage images[3];
+    JobSystem::Handle decodes[3];
+    for(unsigned int i = 0; i < 3; ++i)
+        decodes[i] = jobs->submit([&images, &texturePaths, i](){
+            TraceScope scope("Decode texture");
+            images[i] = decodeImage(texturePaths[i], true);
+        });
+
+    // the native loader parses the OBJ on the job system, anything it can't read goes through Assimp
+    const char* objectPath = "resources/objects/gazelle_model/10020_Gazelle_v04.obj";
+    traceBegin("Load model");
+    Model objectModel;
+    if(!loadObjModel(objectPath, *jobs, objectModel))
+        objectModel.Load(objectPath);
+    traceEnd();
 
     float planeVertices[] = {
             //positions - 3f                   //normals - 3f                      //texture coords - 2f
@@ -407,6 +794,7 @@ int main() {
             1.0f, 1.0f, 1.0f, 1.0f
     };
 
+    traceBegin("Create buffers");
     //plane data
     unsigned int planeVAO, planeVBO, planeEBO;
 
@@ -423,6 +811,8 @@ int main() {
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeIndices), planeIndices, GL_STATIC_DRAW);
+    GpuMemory::tracker().buffer(GPU_GEOMETRY, planeVBO, "Plane vertices", sizeof(planeVertices));
+    GpuMemory::tracker().buffer(GPU_GEOMETRY, planeEBO, "Plane indices", sizeof(planeIndices));
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -445,6 +835,7 @@ int main() {
 
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
+    GpuMemory::tracker().buffer(GPU_GEOMETRY, cubeVBO, "Cube vertices", sizeof(cubeVertices));
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -466,6 +857,7 @@ int main() {
     programState->quadVAO = quadVAO;
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadAAVertices), &quadAAVertices, GL_STATIC_DRAW);
+    GpuMemory::tracker().buffer(GPU_GEOMETRY, quadVBO, "Quad vertices", sizeof(quadAAVertices));
 
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -477,23 +869,39 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
+    traceEnd();
+
     //MSAA framebuffer
+    traceBegin("Create framebuffers");
     unsigned int msaaFBO;
     glGenFramebuffers(1, &msaaFBO);
 
     glBindFramebuffer(GL_FRAMEBUFFER, msaaFBO);
 
-    //color attachment
+    //color attachments, the scene and the bright color, respecified whenever their format changes
     int setSampleNum = programState->sampleNum;
+    msaaSamples = setSampleNum;
+    renderFormats.probe(setSampleNum);
     unsigned int texturesColorBufferMultiSampled[2];
     glGenTextures(2, texturesColorBufferMultiSampled);
-
-    for(unsigned int i = 0; i < 2; ++i){
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texturesColorBufferMultiSampled[i]);
-        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, setSampleNum, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    int msaaFormats[2] = {-1, -1};
+    auto allocateMsaaColor = [&](int sceneFormat, int brightFormat){
+        const int formats[2] = {sceneFormat, brightFormat};
+        const char* names[2] = {"MSAA scene color", "MSAA bright color"};
+        for(unsigned int i = 0; i < 2; ++i){
+            if(formats[i] == msaaFormats[i])
+                continue;
+            msaaFormats[i] = formats[i];
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texturesColorBufferMultiSampled[i]);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, setSampleNum, RenderFormats::internalFormat(formats[i]), SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+            GpuMemory::tracker().texture(GPU_RENDER_TARGETS, texturesColorBufferMultiSampled[i], names[i], RenderFormats::internalFormat(formats[i]),
+                                         SCR_WIDTH, SCR_HEIGHT, 1, setSampleNum);
+        }
+    };
+    allocateMsaaColor(renderFormats.resolve(programState->sceneFormat, true, true), renderFormats.resolve(programState->bloomFormat, true));
+    for(unsigned int i = 0; i < 2; ++i)
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D_MULTISAMPLE, texturesColorBufferMultiSampled[i], 0);
-    }
     unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
     glDrawBuffers(2, attachments);
 
@@ -507,236 +915,504 @@ int main() {
 
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cerr << "ERROR::MSAA_FRAMEBUFFER incomplete";
+    GL_DEBUG_LABEL(GL_FRAMEBUFFER, msaaFBO, "MSAA scene");
+    GL_DEBUG_LABEL(GL_TEXTURE, texturesColorBufferMultiSampled[0], "MSAA scene color");
+    GL_DEBUG_LABEL(GL_TEXTURE, texturesColorBufferMultiSampled[1], "MSAA bright color");
+    GL_DEBUG_LABEL(GL_RENDERBUFFER, rbo, "MSAA depth stencil");
+    GpuMemory::tracker().renderbuffer(rbo, "MSAA depth stencil", GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT, setSampleNum);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    //intermediate fbo
-    unsigned int imFBO;
-    glGenFramebuffers(1, &imFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, imFBO);
-
-    unsigned int screenTextures[2];
-    glGenTextures(2, screenTextures);
-    for(unsigned int i = 0; i < 2; ++i){
-        glBindTexture(GL_TEXTURE_2D, screenTextures[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, screenTextures[i], 0);
-        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cerr << "ERROR::INTERMEDIATE_FRAMEBUFFER incomplete";
-    }
-
-    //intermediate fbo depth renderbuffer
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "ERROR::INTERMEDIATE_FRAMEBUFFER incomplete";
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    //ping pong fbos
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorBuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorBuffers);
-    for(unsigned int i = 0; i < 2; ++i){
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorBuffers[i], 0);
-        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cerr << "ERROR::PINGPONG_FRAMEBUFFER "  << i << "incomplete" << std::endl;
-    }
-
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    traceEnd();
 
     //Gen Textures
-    unsigned int planeTexture = loadTexture("resources/textures/plane.JPG", true);
-    unsigned int cubeTexture = loadTexture("resources/textures/container.png", true);
-    unsigned int cubeSpecTexture = loadTexture("resources/textures/container_specular.png", true);
-
-
-    Cube* firstCube = new Cube();
-    cubes.insert(firstCube);
-    cubes.insert(firstCube->additionalXLaneCube());
+    traceBegin("Upload textures");
+    unsigned int textures[3];
+    for(unsigned int i = 0; i < 3; ++i){
+        jobs->wait(decodes[i]);
+        if(!images[i].data)
+            std::cerr << "ERROR::TEXTURE failed to load at path: " << texturePaths[i] << std::endl;
+        textures[i] = uploadTexture(images[i], true, texturePaths[i]);
+    }
+    traceEnd();
+    unsigned int planeTexture = textures[0];
+    unsigned int cubeTexture = textures[1];
+    unsigned int cubeSpecTexture = textures[2];
+
+    traceBegin("Renderer init");
+    lightCluster = new LightCluster();
+    profiler = new Profiler();
+    profiler->setRenderStats(&renderStats);
+    shadowMaps = new ShadowMaps();
+    DeferredRenderer* deferredRenderer = new DeferredRenderer(SCR_WIDTH, SCR_HEIGHT, quadVAO);
+    renderGraph = new RenderGraph();
+    traceEnd();
+
+    std::vector<uint8_t> cubeVisibility;
+
+    // the first frame renders the initial state
+    writeSnapshot(snapshots.back(), programState->trackLightCount, 0.0f);
+    snapshots.publish();
+
+    traceBegin("First frame");
     // render loop
     // -----------
+    unsigned int presentedInputs = 0;
+    unsigned int savedRevision = 0;
+    autosave.start(PROGRAM_STATE_PATH, AUTOSAVE_INTERVAL);
+    if(argValue(argc, argv, "--format-benchmark")){
+        FormatBenchmark benchmark(blurShader, screenShader, quadVAO, cubeTexture, BLOOM_BLUR_STEPS, BLOOM_DOWNSAMPLE);
+        benchmark.run(renderFormats, argValue(argc, argv, "--format-benchmark"));
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glfwSetWindowShouldClose(window, true);
+    }
+
     while (!glfwWindowShouldClose(window)) {
+        // pacing waits before input is read so the frame starts from the newest key presses,
+        // a window in the background only needs to keep up, not to be smooth
+        bool idle = programState->idleThrottle
+                && (!glfwGetWindowAttrib(window, GLFW_FOCUSED) || glfwGetWindowAttrib(window, GLFW_ICONIFIED));
+        frameLimiter.setVsync(programState->vsyncMode);
+        frameLimiter.wait(idle ? FRAME_LIMITER_IDLE_FPS : programState->fpsLimit, !idle);
+        // key presses become timestamped commands here, the simulation applies them before its tick
+        glfwPollEvents();
+        if(glfwWindowShouldClose(window))
+            break;
+
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        if(player){
+            std::vector<ReplayEvent> events;
+            if(!player->nextFrame(deltaTime, events)){
+                std::cout << "Replay finished after " << player->framesPlayed() << " frames, score "
+                          << snapshots.front().score / 2 << std::endl;
+                glfwSetWindowShouldClose(window, true);
+                deltaTime = 0.0f;
+            }
+            for(ReplayEvent event : events)
+                postGameInput(event);
+        }
+        jobs->runMainThreadJobs();
+        bool deferred = programState->deferredShading;
+        profiler->beginFrame(deferred ? "Deferred" : programState->depthPrePass ? "Forward+pre-pass" : "Forward");
 
         // input
         // -----
         processInput(window);
 
+        // game logic
+        // ----------
+        SimCommand tick = SimCommand();
+        tick.type = SIM_TICK;
+        tick.deltaTime = deltaTime;
+        tick.trackLights = programState->trackLightCount;
+        postSimCommand(tick);
+        if(programState->pipelinedSimulation) {
+            if(!simWorker.active())
+                simWorker.start(runSimulation);
+            simWorker.kick();
+        } else {
+            simWorker.stop();
+            profiler->begin("Simulation");
+            runSimulation();
+            profiler->end();
+        }
+        // pipelined this is usually the previous tick, the worker is still on this one
+        snapshots.update();
+        const RenderSnapshot& snapshot = snapshots.front();
+        if(snapshot.highScore != programState->highScore){
+            programState->highScore = snapshot.highScore;
+            programState->changed();
+        }
+
         // render
         // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, msaaFBO);
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindVertexArray(planeVAO);
-        planeShader.use();
-        setMaterialAttributes(planeShader, programState->planeShininess);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, planeTexture);
-
         glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH/(float)SCR_HEIGHT, 0.1f, 100.0f);
-        planeShader.setMat4("projection", projection);
-        planeShader.setMat4("view", view);
-        setUpShaderLights(planeShader);
-
-
-        for(unsigned int i = 0; i< 5; i++){
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f,0.0f,-2.0f * i - 1.0f));
-            planeShader.setMat4("model", model);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH/(float)SCR_HEIGHT, CAMERA_NEAR, CAMERA_FAR);
+        if(programState->clusteredLighting) {
+            lightCluster->clear();
+            for(const ClusteredLight& light : snapshot.trackLights)
+                lightCluster->addLight(light);
+            // the deferred path draws the track lights one by one and doesn't need them binned
+            if(!deferred)
+                lightCluster->update(view, glm::radians(camera.Zoom), (float)SCR_WIDTH/(float)SCR_HEIGHT, CAMERA_NEAR, CAMERA_FAR, SCR_WIDTH, SCR_HEIGHT);
         }
-        glBindVertexArray(cubeVAO);
-
-        cubeShader.use();
-        cubeShader.setInt("cubeTexture", 0);
-        cubeShader.setMat4("view", view);
-        cubeShader.setMat4("projection", projection);
-        setUpShaderLights(cubeShader);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture);
-        setMaterialAttributes(cubeShader, programState->cubeShininess);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, cubeSpecTexture);
-        cubeShader.setInt("material.specular", 1);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-
-        glEnable(GL_CULL_FACE);
-        glFrontFace(GL_CW);
-
-        float xPos = 0.0f;
-        float deltaZ = 0.0f;
-        for(auto cubeIt = cubes.begin(); cubeIt != cubes.end();){
-            Cube* cube = *cubeIt;
-            xPos = cube->xPos();
-            float zPos = cube->zPos();
-
-            float zPosition = zPos + deltaTime * CUBE_VELOCITY;
-
-            if(deltaZ - zPosition >= 0.01f) {
-                deltaZ = zPosition;
-            }
 
-            if(zPosition + 0.3f >= 0.01f){
-                delete *cubeIt;
-                cubeIt = cubes.erase(cubeIt);
-                programState->score++;
-                continue;
+        // scene geometry, the program has to be in use with its camera uniforms set
+        // the plane is wide enough for the normal three lanes, wider tracks stretch it
+        float trackScale = std::max(1.0f, snapshot.trackWidth / (TRACK_LANES * TRACK_LANE_WIDTH));
+        auto drawTrack = [&](Shader& program){
+            glBindVertexArray(planeVAO);
+            for(unsigned int i = 0; i < TRACK_CHUNKS; i++){
+                for(float tileZ = 0.0f; tileZ < TRACK_CHUNK_LENGTH; tileZ += TRACK_TILE_LENGTH){
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, glm::vec3(0.0f,0.0f,snapshot.chunkZ[i] - tileZ - TRACK_TILE_LENGTH * 0.5f));
+                    model = glm::scale(model, glm::vec3(trackScale, 1.0f, 1.0f));
+                    program.setMat4("model", model);
+                    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                }
+            }
+        };
+        // both return how many objects passed the frustum test
+        auto drawCubes = [&](Shader& program, const Frustum& frustum){
+            // the frustum tests are spread over the job system, only the draws stay on this thread
+            const std::vector<glm::vec3>& positions = snapshot.obstacles;
+            cubeVisibility.resize(positions.size());
+            jobs->parallelFor(0, positions.size(), CULL_OBJECTS_PER_JOB, [&](unsigned int first, unsigned int last){
+                for(unsigned int i = first; i < last; ++i)
+                    cubeVisibility[i] = frustum.sphereVisible(positions[i], CUBE_RADIUS);
+            });
+            unsigned int drawn = 0;
+            glBindVertexArray(cubeVAO);
+            for(unsigned int i = 0; i < positions.size(); ++i){
+                if(!cubeVisibility[i])
+                    continue;
+                program.setMat4("model", Cube::modelAt(positions[i]));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                drawn++;
+            }
+            return drawn;
+        };
+        // the player's gazelle and the extra stress instances in rows on both sides of the track
+        unsigned int gazelleCount = 1 + snapshot.extraGazelles;
+        auto gazellePosition = [&](unsigned int i){
+            if(i == 0)
+                return snapshot.player;
+            unsigned int extra = (i - 1) / 2;
+            float side = i % 2 ? -1.0f : 1.0f;
+            return glm::vec3(side * (snapshot.trackWidth * 0.5f + 0.5f + 0.6f * (extra % 8)), 0.0f, -0.7f - 1.2f * (extra / 8));
+        };
+        auto drawGazelle = [&](Shader& program, bool textured, const Frustum& frustum){
+            unsigned int drawn = 0;
+            for(unsigned int i = 0; i < gazelleCount; ++i){
+                glm::vec3 position = gazellePosition(i);
+                if(!frustum.sphereVisible(position, GAZELLE_RADIUS))
+                    continue;
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, position);
+                model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+                model = glm::rotate(model, glm::radians(-180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+                model = glm::scale(model, glm::vec3(0.006f));
+                program.setMat4("model", model);
+                drawn++;
+                if(textured) {
+                    objectModel.Draw(program);
+                    continue;
+                }
+                for(Mesh& mesh : objectModel.meshes){
+                    glBindVertexArray(mesh.VAO);
+                    glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
+                }
+            }
+            glBindVertexArray(0);
+            return drawn;
+        };
+        Frustum cameraFrustum(projection * view);
+
+        // draws the track, the cubes and the model, lit shaders also get the lights uploaded
+        // and the depth pass only binds the geometry
+        // the obstacle cubes, at the depth test drawScene left set up
+        auto drawObstacles = [&](Shader& cubeProgram, ScenePass pass){
+            bool lit = pass == SCENE_PASS_LIT;
+            bool textured = pass != SCENE_PASS_DEPTH;
+            cubeProgram.use();
+            cubeProgram.setMat4("view", view);
+            cubeProgram.setMat4("projection", projection);
+            if(lit)
+                setUpShaderLights(cubeProgram);
+            if(textured) {
+                cubeProgram.setInt("cubeTexture", 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, cubeTexture);
+                setMaterialAttributes(cubeProgram, programState->cubeShininess);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, cubeSpecTexture);
+                cubeProgram.setInt("material.specular", 1);
             }
 
-            if(comparableFloat(zPosition) >= comparableFloat(-1.2f) && comparableFloat(xModelPos) == comparableFloat(xPos)){
-                cubes.clear();
-                collided = true;
-                if(programState->highScore < programState->score)
-                    programState->highScore = programState->score / 2;
-                break;
+            glEnable(GL_CULL_FACE);
+            glFrontFace(GL_CW);
+            visibleObstacles = drawCubes(cubeProgram, cameraFrustum);
+        };
+
+        // without cubes the obstacles are left to a drawObstacles call of their own
+        auto drawScene = [&](Shader& planeProgram, Shader& cubeProgram, Shader& modelProgram, ScenePass pass, GLenum depthFunc,
+                             bool cubes){
+            bool lit = pass == SCENE_PASS_LIT;
+            bool textured = pass != SCENE_PASS_DEPTH;
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(depthFunc);
+            // the track is drawn without culling, every pass has to agree on that for GL_EQUAL to match
+            glDisable(GL_CULL_FACE);
+
+            planeProgram.use();
+            if(textured) {
+                setMaterialAttributes(planeProgram, programState->planeShininess);
+                planeProgram.setInt("material.specular", 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, planeTexture);
+            }
+            planeProgram.setMat4("projection", projection);
+            planeProgram.setMat4("view", view);
+            if(lit)
+                setUpShaderLights(planeProgram);
+            drawTrack(planeProgram);
+
+            if(cubes)
+                drawObstacles(cubeProgram, pass);
+            else{
+                glEnable(GL_CULL_FACE);
+                glFrontFace(GL_CW);
             }
 
+            if(&modelProgram != (cubes ? &cubeProgram : &planeProgram))
+                modelProgram.use();
+            modelProgram.setMat4("projection", projection);
+            modelProgram.setMat4("view", view);
+            if(lit)
+                setUpShaderLights(modelProgram);
+            if(textured) {
+                // the G-buffer program reads the model's diffuse texture through the material samplers
+                setMaterialAttributes(modelProgram, 32.0f);
+                modelProgram.setInt("material.specular", 0);
+            }
+            visibleGazelles = drawGazelle(modelProgram, textured, cameraFrustum);
+        };
+
+        // the frame's passes, the graph culls what nothing reads from and places the post-processing
+        // targets in shared textures
+        renderGraph->reset();
+        GLenum sceneFormat = RenderFormats::internalFormat(renderFormats.resolve(programState->sceneFormat, false, true));
+        GLenum bloomFormat = RenderFormats::internalFormat(renderFormats.resolve(programState->bloomFormat, false));
+        allocateMsaaColor(renderFormats.resolve(programState->sceneFormat, true, true), renderFormats.resolve(programState->bloomFormat, true));
+        const RenderTargetDesc sceneTarget = {sceneFormat, (int)SCR_WIDTH, (int)SCR_HEIGHT};
+        const RenderTargetDesc brightTarget = {bloomFormat, (int)SCR_WIDTH, (int)SCR_HEIGHT};
+        const RenderTargetDesc bloomTarget = {bloomFormat, (int)SCR_WIDTH / BLOOM_DOWNSAMPLE, (int)SCR_HEIGHT / BLOOM_DOWNSAMPLE};
+        int backbuffer = renderGraph->importFramebuffer("Backbuffer", 0);
+        int shadowCascades = renderGraph->importTexture("Shadow cascades", 0);
+        int sceneColor = renderGraph->createTexture("Scene color", sceneTarget);
+        // what the blur starts from, the thresholded bright color of either path
+        int bloomSource = sceneColor;
+        renderGraph->markOutput(backbuffer);
+
+        if(programState->shadows){
+            renderGraph->addPass("Shadows", {}, {shadowCascades}, [&](){
+                // the track only goes into the cached static layer, what moves is redrawn every frame
+                bool redrawStatic = shadowMaps->update(programState->dirLight.direction, view, glm::radians(camera.Zoom),
+                                                       (float)SCR_WIDTH/(float)SCR_HEIGHT, CAMERA_NEAR, snapshot.trackVersion)
+                                    || !programState->shadowCache;
+                depthShader.use();
+                depthShader.setMat4("projection", glm::mat4(1.0f));
+                shadowMaps->beginPass();
+                if(redrawStatic){
+                    for(unsigned int i = 0; i < CSM_CASCADES; ++i){
+                        shadowMaps->beginCascade(true, i);
+                        depthShader.setMat4("view", shadowMaps->lightSpace(i));
+                        drawTrack(depthShader);
+                    }
+                }
+                for(unsigned int i = 0; i < CSM_CASCADES; ++i){
+                    shadowMaps->beginCascade(false, i);
+                    depthShader.setMat4("view", shadowMaps->lightSpace(i));
+                    Frustum cascadeFrustum(shadowMaps->lightSpace(i), false);
+                    drawCubes(depthShader, cascadeFrustum);
+                    drawGazelle(depthShader, false, cascadeFrustum);
+                }
+                shadowMaps->endPass(SCR_WIDTH, SCR_HEIGHT, redrawStatic);
+            });
+        }
 
-            glm::mat4 model = cube->translate(xPos, 0.0f, zPosition);
-            cubeShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            ++cubeIt;
+        if(deferred){
+            int gBuffer = renderGraph->importTexture("G-buffer", 0);
+            renderGraph->addPass("G-buffer", {}, {gBuffer}, [&](){
+                deferredRenderer->beginGeometryPass();
+                drawScene(gBufferPlaneShader, gBufferCubeShader, gBufferModelShader, SCENE_PASS_GBUFFER, GL_LESS, true);
+                deferredRenderer->endGeometryPass();
+            });
+            renderGraph->addPass("Lighting", {gBuffer, shadowCascades}, {sceneColor}, [&](){
+                glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                deferredRenderer->lightingPass(view, projection, glm::radians(camera.Zoom), CAMERA_NEAR, CAMERA_FAR,
+                                               camera.Position, programState->dirLight, programState->pointLight,
+                                               programState->spotLight, programState->clusteredLighting ? lightCluster : nullptr,
+                                               programState->shadows ? shadowMaps : nullptr);
+            });
+            // lights are added one pass each, only their sum can be thresholded, so the bright color
+            // is cut out of the lit scene afterwards. Culled with the blur when bloom is off.
+            bloomSource = renderGraph->createTexture("Bright color", brightTarget);
+            renderGraph->addPass("Bright pass", {sceneColor}, {bloomSource}, [&](){
+                glDisable(GL_DEPTH_TEST);
+                glDisable(GL_CULL_FACE);
+                brightShader.use();
+                brightShader.setInt("scene", 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderGraph->texture(sceneColor));
+                renderQuad();
+            });
         }
-        if((deltaZ > CUBE_Z_SPAWN_FACTOR) && !collided) {
-            Cube* newCube = new Cube();
-            cubes.insert(newCube);
-            cubes.insert(newCube->additionalXLaneCube());
+        else{
+            int sceneMultisampled = renderGraph->importFramebuffer("MSAA scene", msaaFBO);
+            renderGraph->addPass("Forward scene", {shadowCascades}, {sceneMultisampled}, [&](){
+                glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                if(programState->depthPrePass){
+                    // lay down the nearest depth first so the lit pass only shades visible fragments.
+                    // The cubes are translucent, what is behind them has to stay visible, so they are
+                    // left out and blended over the rest last, tested against the pre-pass depth.
+                    profiler->begin("Depth pre-pass");
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    drawScene(depthShader, depthShader, depthShader, SCENE_PASS_DEPTH, GL_LESS, false);
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    profiler->end();
+
+                    glDepthMask(GL_FALSE);
+                    drawScene(planeShader, cubeShader, modelShader, SCENE_PASS_LIT, GL_EQUAL, false);
+                    glDepthFunc(GL_LESS);
+                    drawObstacles(cubeShader, SCENE_PASS_LIT);
+                    glDepthMask(GL_TRUE);
+                }
+                else
+                    drawScene(planeShader, cubeShader, modelShader, SCENE_PASS_LIT, GL_LESS, true);
+            });
+            // one pass over both multisampled attachments instead of a blit, which could only resolve
+            // the scene, writing the resolved scene and the bright color the bloom starts from
+            RenderGraph::PassFunction resolve = [&](){
+                glDisable(GL_DEPTH_TEST);
+                glDisable(GL_CULL_FACE);
+                resolveShader.use();
+                resolveShader.setInt("scene", 0);
+                resolveShader.setInt("bright", 1);
+                resolveShader.setInt("samples", setSampleNum);
+                resolveShader.setInt("bloom", programState->bloom);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texturesColorBufferMultiSampled[0]);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texturesColorBufferMultiSampled[1]);
+                renderQuad();
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+            };
+            if(programState->bloom){
+                bloomSource = renderGraph->createTexture("Bright color", brightTarget);
+                renderGraph->addPass("Resolve", {sceneMultisampled}, {sceneColor, bloomSource}, resolve);
+            }
+            else
+                renderGraph->addPass("Resolve", {sceneMultisampled}, {sceneColor}, resolve);
         }
 
-        modelShader.use();
-
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(xModelPos, 0.0f, -0.7f));
-        model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(-180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.006f));
-
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-        modelShader.setMat4("model", model);
-        setUpShaderLights(modelShader);
-
-        objectModel.Draw(modelShader);
-
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFBO);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, imFBO);
-        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        //pingponging
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        blurShader.setInt("image", 0);
-        for(unsigned int i = 0; i < amount; ++i)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? screenTextures[i] : pingpongColorBuffers[!horizontal]);
-            renderQuad();
-            horizontal = !horizontal;
-            if(first_iteration)
-                first_iteration = false;
+        // every blur step writes a texture of its own, the graph makes them ping-pong between two.
+        // The first step downsamples too, its taps are spaced in the smaller target's texels so
+        // each bilinear one averages a different 2x2 block of the source and the radius matches
+        // the later steps. Without bloom nothing reads the result and the whole chain is culled.
+        int blurred = bloomSource;
+        for(unsigned int i = 0; i < BLOOM_BLUR_STEPS; ++i){
+            int source = blurred;
+            bool horizontal = i % 2 == 0;
+            blurred = renderGraph->createTexture("Bloom blur", bloomTarget);
+            renderGraph->addPass("Bloom blur", {source}, {blurred}, [&, i, source, horizontal](){
+                if(i == 0){
+                    glViewport(0, 0, SCR_WIDTH / BLOOM_DOWNSAMPLE, SCR_HEIGHT / BLOOM_DOWNSAMPLE);
+                    glDisable(GL_DEPTH_TEST);
+                    glDisable(GL_CULL_FACE);
+                    blurShader.use();
+                    blurShader.setInt("image", 0);
+                    blurShader.setVec2("texelSize", 1.0f / (SCR_WIDTH / BLOOM_DOWNSAMPLE), 1.0f / (SCR_HEIGHT / BLOOM_DOWNSAMPLE));
+                    glActiveTexture(GL_TEXTURE0);
+                }
+                blurShader.setInt("horizontal", horizontal);
+                glBindTexture(GL_TEXTURE_2D, renderGraph->texture(source));
+                renderQuad();
+            });
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        screenShader.use();
-        screenShader.setInt("scene", 0);
-        screenShader.setInt("bloomBlur", 1);
-        screenShader.setInt("bloom", programState->bloom);
-        screenShader.setFloat("exposure", programState->exposure);
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, screenTextures[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorBuffers[!horizontal]);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        int bloomInput = programState->bloom ? blurred : sceneColor;
+        renderGraph->addPass("Composite", {sceneColor, bloomInput}, {backbuffer}, [&](){
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            screenShader.use();
+            screenShader.setInt("scene", 0);
+            screenShader.setInt("bloomBlur", 1);
+            screenShader.setInt("bloom", programState->bloom);
+            screenShader.setFloat("exposure", programState->exposure);
+            glBindVertexArray(quadVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, renderGraph->texture(sceneColor));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, programState->bloom ? renderGraph->texture(blurred) : 0);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        });
+
+        renderGraph->compile();
+        renderGraph->execute(profiler);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
+        profiler->begin("ImGui");
         if(programState->ImGuiEnabled){
-            drawImGui();
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+            if(uiNeedsRebuild(window))
+                drawImGui(snapshot);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         }
         else
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            ui.builtAt = -1.0;
+        setCursorVisible(window, programState->ImGuiEnabled);
+        profiler->end();
+        profiler->endFrame();
+
+        // a copy goes to the save thread, it is written once the autosave interval has passed
+        if(programState->revision != savedRevision){
+            savedRevision = programState->revision;
+            ProgramState state = *programState;
+            autosave.submit([state](){ return state.serialize(); });
+        }
 
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        // the newest key press this frame shows, pipelined that is usually one from the frame before
+        if(snapshot.inputCount != presentedInputs){
+            presentedInputs = snapshot.inputCount;
+            profiler->inputLatency((float)((glfwGetTime() - snapshot.inputTime) * 1000.0));
+        }
+
+        if(Trace::active().load()){
+            traceEnd();
+            traceEnd();
+            Trace::active() = nullptr;
+            if(startupTrace.write(tracePath))
+                std::cout << "Startup trace written to " << tracePath << std::endl;
+        }
     }
-    programState->SaveToFile("resources/program_state.txt");
-    cubes.clear();
+    simWorker.stop();
+    // the last simulated tick may not have been presented, its high score is only in the game state
+    programState->highScore = std::max(programState->highScore, gameHighScore);
+    ProgramState finalState = *programState;
+    autosave.submit([finalState](){ return finalState.serialize(); });
+    autosave.stop();
+    obstacles.clear();
+    delete deferredRenderer;
+    delete renderGraph;
+    delete profiler;
+    delete shadowMaps;
+    delete track;
+    delete recorder;
+    delete player;
+    delete jobs;
+    delete lightCluster;
+    glDeleteFramebuffers(1, &msaaFBO);
+    for(unsigned int i = 0; i < 2; ++i)
+        GpuMemory::tracker().release(GPU_TEXTURE, texturesColorBufferMultiSampled[i]);
+    glDeleteTextures(2, texturesColorBufferMultiSampled);
+    for(unsigned int i = 0; i < 3; ++i)
+        GpuMemory::tracker().release(GPU_TEXTURE, textures[i]);
+    glDeleteTextures(3, textures);
+    GpuMemory::tracker().release(GPU_RENDERBUFFER, rbo);
+    glDeleteRenderbuffers(1, &rbo);
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -744,24 +1420,27 @@ int main() {
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods){
-    if(key == GLFW_KEY_LEFT && action == GLFW_PRESS && xModelPos > -0.66f){
-        xModelPos -= 0.66f;
+    ui.inputSerial++;
+    if(key == GLFW_KEY_LEFT && action == GLFW_PRESS && !player){
+        postGameInput(REPLAY_LEFT, glfwGetTime());
     }
 
-    if(key == GLFW_KEY_RIGHT && action == GLFW_PRESS && xModelPos < 0.66f){
-        xModelPos += 0.66f;
+    if(key == GLFW_KEY_RIGHT && action == GLFW_PRESS && !player){
+        postGameInput(REPLAY_RIGHT, glfwGetTime());
     }
 
-    if(key == GLFW_KEY_R && action == GLFW_PRESS){
-        resetGame();
+    if(key == GLFW_KEY_R && action == GLFW_PRESS && !player){
+        postGameInput(REPLAY_RESET, glfwGetTime());
     }
 
     if(key == GLFW_KEY_F1 && action == GLFW_PRESS){
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
+        programState->changed();
     }
 
     if(key == GLFW_KEY_B && action == GLFW_PRESS){
         programState->bloom = !programState->bloom;
+        programState->changed();
     }
 }
 
@@ -778,6 +1457,46 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    ui.inputSerial++;
+}
+
+void ui_mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    ui.inputSerial++;
+}
+
+void ui_scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+    ui.inputSerial++;
+}
+
+void ui_char_callback(GLFWwindow *window, unsigned int codepoint) {
+    ui.inputSerial++;
+}
+
+// the cursor is polled since nothing else needs a callback for it
+bool uiNeedsRebuild(GLFWwindow *window) {
+    double now = glfwGetTime();
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    if(ui.inputSerial != ui.builtSerial || x != ui.cursorX || y != ui.cursorY)
+        ui.settleFrames = UI_SETTLE_FRAMES;
+    else if(ui.settleFrames > 0)
+        ui.settleFrames--;
+    else if(ui.builtAt >= 0.0 && now - ui.builtAt < UI_REFRESH_INTERVAL)
+        return false;
+    ui.builtSerial = ui.inputSerial;
+    ui.cursorX = x;
+    ui.cursorY = y;
+    ui.builtAt = now;
+    ui.rebuilds++;
+    return true;
+}
+
+// changing the input mode is a round trip to the window system, so it only happens on a toggle
+void setCursorVisible(GLFWwindow *window, bool visible) {
+    if(visible == ui.cursorVisible)
+        return;
+    ui.cursorVisible = visible;
+    glfwSetInputMode(window, GLFW_CURSOR, visible ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -827,9 +1546,11 @@ void setUpShaderLights(Shader shader){
     shader.setFloat("pointLight.quadratic", programState->pointLight.quadratic);
 
     shader.setVec3("viewPos", camera.Position);
+    lightCluster->bind(shader, programState->clusteredLighting);
+    shadowMaps->bind(shader, programState->shadows);
 }
 
-void drawImGui()
+void drawImGui(const RenderSnapshot& snapshot)
 {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -842,10 +1563,67 @@ void drawImGui()
         ImGui::DragInt("Sample number", (int *) &programState->sampleNum, 2, 2, 8);
         ImGui::DragFloat("Exposure", (float *) &programState->exposure, 0.1, 0.1, 10);
         ImGui::Checkbox("Enable Bloom", (bool *) &programState->bloom);
+        const char* formats[] = {RenderFormats::name(FORMAT_RGBA16F), RenderFormats::name(FORMAT_R11G11B10F), RenderFormats::name(FORMAT_RGB10A2)};
+        // RGB10A2 comes last, the scene's combo leaves it out since it clamps the HDR range
+        ImGui::Combo("Scene format", &programState->sceneFormat, formats, FORMAT_RGB10A2);
+        ImGui::Combo("Bloom format", &programState->bloomFormat, formats, FORMAT_COUNT);
+        int sceneFormat = renderFormats.resolve(programState->sceneFormat, false, true);
+        int bloomFormat = renderFormats.resolve(programState->bloomFormat, false);
+        if(sceneFormat != programState->sceneFormat || bloomFormat != programState->bloomFormat)
+            ImGui::Text("Using %s for the scene and %s for bloom", RenderFormats::name(sceneFormat), RenderFormats::name(bloomFormat));
+        if(bloomFormat == FORMAT_RGB10A2)
+            ImGui::Text("RGB10A2 clamps bloom values above 1");
         ImGui::DragFloat("Cube shininess", (float*)&programState->cubeShininess, 2, 2);
         ImGui::DragFloat("Plane shininess", (float*)&programState->planeShininess, 2, 2);
-        ImGui::Text("Score: %d", programState->score / 2);
-        ImGui::Text("Highest score: %d", programState->highScore);
+        ImGui::Checkbox("Deferred shading", &programState->deferredShading);
+        ImGui::Checkbox("Depth pre-pass (forward)", &programState->depthPrePass);
+        ImGui::Checkbox("Shadows", &programState->shadows);
+        ImGui::Checkbox("Cache static shadows", &programState->shadowCache);
+        ImGui::Text("Static shadow layer renders: %u", shadowMaps->staticRenderCount());
+        ImGui::Checkbox("Clustered lighting", &programState->clusteredLighting);
+        ImGui::SliderInt("Track lights", &programState->trackLightCount, 0, CLUSTER_MAX_LIGHTS);
+        if(programState->clusteredLighting)
+            ImGui::Text("Cluster lights: %u, max per cluster: %u, indices: %u", lightCluster->lightCount(),
+                        lightCluster->maxPerCluster(), lightCluster->indexCount());
+        ImGui::Checkbox("Pipelined simulation", &programState->pipelinedSimulation);
+        const char* vsyncModes[] = {"Off", "On", "Adaptive"};
+        ImGui::Combo("VSync", &programState->vsyncMode, vsyncModes, 3);
+        ImGui::SliderInt("FPS limit (0 = off)", &programState->fpsLimit, 0, 240);
+        ImGui::Checkbox("Throttle in background", &programState->idleThrottle);
+        ImGui::Text("Simulation: %.3f ms", snapshot.simulationMs);
+        ImGui::Text("Score: %d", snapshot.score / 2);
+        ImGui::Text("Highest score: %d", snapshot.highScore);
+        ImGui::Text("Session seed: %llu, run seed: %llu", (unsigned long long)sessionSeed, (unsigned long long)snapshot.runSeed);
+        ImGui::Text("Overlay rebuilds: %u", ui.rebuilds);
+        ImGui::End();
+    }
+    {
+        ImGui::Begin("GPU memory");
+        ImGui::Text("%u x %u, %d samples", SCR_WIDTH, SCR_HEIGHT, msaaSamples);
+        if(ImGui::SliderInt("Budget (MB)", &programState->gpuBudgetMB, 64, 8192))
+            GpuMemory::tracker().setBudget((uint64_t)programState->gpuBudgetMB * 1024 * 1024);
+        GpuMemory::tracker().drawImGui();
+        ImGui::Text("Render graph: %u of %u passes, %u transient textures in %u targets", renderGraph->livePassCount(),
+                    renderGraph->passCount(), renderGraph->transientCount(), renderGraph->targetCount());
+        ImGui::End();
+    }
+    {
+        ImGui::Begin("Stress test");
+        ImGui::SliderInt("Lanes", &stressPending.lanes, 2, TRACK_MAX_LANES);
+        ImGui::SliderInt("Rows per chunk", &stressPending.rowsPerChunk, 1, TRACK_MAX_ROWS);
+        ImGui::DragFloat("Obstacle speed", &stressPending.speed, 0.1f, 0.1f, 50.0f);
+        ImGui::SliderInt("Extra gazelles", &stressPending.extraGazelles, 0, STRESS_MAX_GAZELLES);
+        // a replay has to keep the rules it was recorded with
+        if(recorder || player)
+            ImGui::Text("Fixed while recording or replaying");
+        else if(ImGui::Button("Restart with these settings")) {
+            SimCommand command = SimCommand();
+            command.type = SIM_APPLY_STRESS;
+            command.stress = stressPending;
+            postSimCommand(command);
+        }
+        ImGui::Text("Obstacles: %u, drawn: %u", (unsigned int)snapshot.obstacles.size(), visibleObstacles);
+        ImGui::Text("Gazelles: %d, drawn: %u", 1 + snapshot.extraGazelles, visibleGazelles);
         ImGui::End();
     }
     {
@@ -880,18 +1658,216 @@ void drawImGui()
         ImGui::End();
     }
 
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-}
+    profiler->drawImGui();
+    RenderStats::active()->drawImGui();
 
-int comparableFloat(float val){
-    return (int)(val * 100);
+    // widgets write straight into the program state, any of them being used may have changed it
+    if(ImGui::IsAnyItemActive())
+        programState->changed();
+
+    ImGui::Render();
 }
 
 void resetGame(){
-    cubes.clear();
+    obstacles.clear();
     collided = false;
-    programState->score = 0;
+    gameScore = 0;
+    runSeed = nextRunSeed();
+    track->reset(runSeed);
+}
+
+// the obstacle rules only change between runs so the swept buckets and rows stay consistent
+void applyStressSettings(const StressSettings& settings){
+    stress = settings;
+    track->configure(stress.lanes, stress.rowsPerChunk);
+    stress.lanes = track->lanes();
+    stress.rowsPerChunk = track->rowsPerChunk();
+    obstacles.setLanes(track->lanes());
+    playerLane = track->lanes() / 2;
+    resetGame();
+}
+
+uint64_t nextRunSeed(){
+    uint64_t high = sessionRandom.next();
+    return (high << 32u) | sessionRandom.next();
+}
+
+// advances the obstacles and checks collisions, touches no GL state so replays can run it headless
+void updateGame(float dt){
+    if(collided)
+        return;
+
+    float distance = dt * stress.speed;
+    if(obstacles.sweep(playerLane, distance)){
+        obstacles.clear();
+        collided = true;
+        if(gameHighScore < gameScore / 2)
+            gameHighScore = gameScore / 2;
+        return;
+    }
+    gameScore += obstacles.advance(distance, *jobs);
+
+    // new rows are spawned where the track already is after this tick
+    track->scroll(distance, [](unsigned int lane, float z){
+        obstacles.add(lane, new Cube(track->laneX(lane), 0.0f, z));
+    });
+}
+
+// the queue only fills up if the worker falls 1024 commands behind, then the main thread waits for it
+void postSimCommand(const SimCommand& command){
+    while(!simCommands.push(command)){
+        if(simWorker.active()) {
+            simWorker.kick();
+            std::this_thread::yield();
+        } else {
+            runSimulation();
+        }
+    }
+}
+
+void postGameInput(ReplayEvent event, double time){
+    SimCommand command = SimCommand();
+    command.type = SIM_INPUT;
+    command.event = event;
+    command.inputTime = time;
+    postSimCommand(command);
+}
+
+// drains the command queue, runs on the worker when pipelined and on the main thread otherwise
+void runSimulation(){
+    SimCommand command;
+    while(simCommands.pop(command)){
+        switch(command.type){
+            case SIM_INPUT:
+                applyGameInput(command.event);
+                if(command.inputTime > 0.0){
+                    appliedInputs++;
+                    appliedInputTime = command.inputTime;
+                }
+                break;
+            case SIM_APPLY_STRESS:
+                applyStressSettings(command.stress);
+                break;
+            case SIM_TICK: {
+                auto start = std::chrono::steady_clock::now();
+                if(recorder)
+                    recorder->frame(command.deltaTime);
+                updateGame(command.deltaTime);
+                float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                writeSnapshot(snapshots.back(), command.trackLights, ms);
+                snapshots.publish();
+                break;
+            }
+        }
+    }
+}
+
+// copies what the renderer needs, the snapshot vectors keep their storage between ticks
+void writeSnapshot(RenderSnapshot& snapshot, int trackLights, float simulationMs){
+    snapshot.obstacles.clear();
+    obstacles.forEach([&](Cube* cube){
+        snapshot.obstacles.push_back(glm::vec3(cube->xPos(), 0.0f, cube->zPos()));
+    });
+    buildTrackLights(snapshot.trackLights, trackLights);
+    for(unsigned int i = 0; i < TRACK_CHUNKS; ++i)
+        snapshot.chunkZ[i] = track->chunk(i).z;
+    snapshot.trackVersion = track->version();
+    snapshot.trackWidth = track->width();
+    snapshot.player = glm::vec3(track->laneX(playerLane), 0.0f, -0.7f);
+    snapshot.extraGazelles = stress.extraGazelles;
+    snapshot.score = gameScore;
+    snapshot.highScore = gameHighScore;
+    snapshot.runSeed = runSeed;
+    snapshot.simulationMs = simulationMs;
+    snapshot.inputCount = appliedInputs;
+    snapshot.inputTime = appliedInputTime;
+}
+
+// every input that changes the game goes through here so it can be recorded
+void applyGameInput(ReplayEvent event){
+    if(recorder)
+        recorder->event(event);
+    switch(event){
+        case REPLAY_LEFT:
+            if(playerLane > 0)
+                playerLane--;
+            break;
+        case REPLAY_RIGHT:
+            if(playerLane + 1 < track->lanes())
+                playerLane++;
+            break;
+        case REPLAY_RESET:
+            resetGame();
+            break;
+    }
+}
+
+// plays the whole replay through the game logic as fast as possible, without a window
+int runHeadlessReplay(){
+    auto start = std::chrono::steady_clock::now();
+    float deltaTime;
+    std::vector<ReplayEvent> events;
+    while(player->nextFrame(deltaTime, events)){
+        for(ReplayEvent event : events)
+            applyGameInput(event);
+        updateGame(deltaTime);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << player->framesPlayed() << " frames in " << ms << " ms ("
+              << ms * 1000.0 / std::max(player->framesPlayed(), 1u) << " us/frame)" << std::endl;
+    std::cout << "Score " << gameScore / 2 << ", highest score " << gameHighScore
+              << ", run seed " << runSeed << std::endl;
+    obstacles.clear();
+    delete track;
+    delete player;
+    delete programState;
+    delete jobs;
+    return 0;
+}
+
+const char* argValue(int argc, char** argv, const char* name){
+    for(int i = 1; i + 1 < argc; ++i)
+        if(std::strcmp(argv[i], name) == 0)
+            return argv[i + 1];
+    return nullptr;
+}
+
+bool hasArg(int argc, char** argv, const char* name){
+    for(int i = 1; i < argc; ++i)
+        if(std::strcmp(argv[i], name) == 0)
+            return true;
+    return false;
+}
+
+// lines both sides of the track with point lights and hangs a spot light over every fourth pair
+void buildTrackLights(std::vector<ClusteredLight>& lights, int count)
+{
+    const glm::vec3 colors[] = {
+            glm::vec3(1.0f, 0.55f, 0.2f),
+            glm::vec3(0.3f, 0.6f, 1.0f),
+            glm::vec3(0.4f, 1.0f, 0.5f)
+    };
+    // the pattern repeats every 12 pairs, wrapping the distance there keeps the positions precise on long runs
+    float scrolled = (float)std::fmod(track->distance(), TRACK_LIGHT_SPACING * 12.0);
+    int firstPair = (int)(scrolled / TRACK_LIGHT_SPACING);
+    lights.clear();
+    for(int i = 0; i < count; ++i){
+        int pair = firstPair + i / 2;
+        float z = -TRACK_LIGHT_SPACING * pair - 0.5f + scrolled;
+        ClusteredLight light;
+        light.spot = (pair % 4 == 3) && (i % 2 == 0);
+        light.position = light.spot ? glm::vec3(0.0f, 1.2f, z)
+                                    : glm::vec3(i % 2 == 0 ? -1.1f : 1.1f, 0.3f, z);
+        light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        light.diffuse = colors[pair % 3];
+        light.specular = colors[pair % 3] * 0.5f;
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.quadratic = 1.8f;
+        light.cutOff = glm::cos(glm::radians(20.0f));
+        light.outerCutOff = glm::cos(glm::radians(28.0f));
+        lights.push_back(light);
+    }
 }
 
 void renderQuad()
@@ -901,49 +1877,83 @@ void renderQuad()
     glBindVertexArray(0);
 }
 
-unsigned int loadTexture(char const* path, bool gammaCorrection)
+DecodedImage decodeImage(char const* path, bool flipVertically)
+{
+    DecodedImage image;
+    // stb_image's own flip is a global switch, rows are flipped here so loads on other threads aren't affected
+    AssetFile file(path);
+    if(file.data())
+        image.data = stbi_load_from_memory((const stbi_uc*)file.data(), (int)file.size(), &image.width, &image.height, &image.channels, 0);
+    if(image.data && flipVertically)
+    {
+        size_t rowSize = (size_t)image.width * image.channels;
+        std::vector<unsigned char> row(rowSize);
+        for(int y = 0; y < image.height / 2; ++y)
+        {
+            unsigned char* top = image.data + y * rowSize;
+            unsigned char* bottom = image.data + (image.height - 1 - y) * rowSize;
+            std::copy(top, top + rowSize, row.begin());
+            std::copy(bottom, bottom + rowSize, top);
+            std::copy(row.begin(), row.end(), bottom);
+        }
+    }
+    return image;
+}
+
+// creates the texture and frees the pixels, an image that failed to decode leaves the texture empty
+unsigned int uploadTexture(DecodedImage& image, bool gammaCorrection, const char* name)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrChannels;
-
-    unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if(data)
+    if(image.data)
     {
         GLenum internalFormat;
         GLenum dataFormat;
 
-        if(nrChannels == 1)
+        if(image.channels == 1)
         {
             internalFormat = dataFormat = GL_RED;
         }
-        else if(nrChannels == 3)
+        else if(image.channels == 2)
+        {
+            internalFormat = dataFormat = GL_RG;
+        }
+        else if(image.channels == 3)
         {
             internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
             dataFormat = GL_RGB;
         }
-        else if(nrChannels == 4)
+        else if(image.channels == 4)
         {
             internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
             dataFormat = GL_RGBA;
         }
+        else
+        {
+            std::cerr << "ERROR::TEXTURE " << name << " has " << image.channels << " channels" << std::endl;
+            stbi_image_free(image.data);
+            image.data = nullptr;
+            return textureID;
+        }
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, image.data);
+        if(image.channels == 2)
+        {
+            // grey and alpha, sampled as a grey color
+            GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
         glGenerateMipmap(GL_TEXTURE_2D);
+        GpuMemory::tracker().texture(GPU_TEXTURES, textureID, name, internalFormat, image.width, image.height, 1, 1, true);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cerr << "ERROR::TEXTURE failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
+    stbi_image_free(image.data);
+    image.data = nullptr;
 
     return textureID;
 }
@@ -0,0 +1,40 @@
+// Checks that the track hands out obstacles nearest first in every lane, which ObstacleLanes
+// relies on, also when one scroll recycles chunks on both sides of the ring's wrap.
+//
+//  track_test
+//
+// Exits with 1 and names the lane on the first obstacle spawned nearer than an earlier one.
+#include "rg/Track.hpp"
+
+#include <iostream>
+#include <vector>
+
+int main(){
+    Track track(42);
+    // z every lane's last obstacle had when it was spawned, moved along with the track since
+    std::vector<float> last(track.lanes(), 1.0e9f);
+    bool ordered = true;
+    auto scroll = [&](float distance){
+        for(float& z : last)
+            z += distance;
+        track.scroll(distance, [&](unsigned int lane, float z){
+            if(z > last[lane]){
+                std::cerr << "ERROR::TRACK_TEST lane " << lane << " got z " << z << " after " << last[lane] << std::endl;
+                ordered = false;
+            }
+            last[lane] = z;
+        });
+    };
+
+    // the first three chunks are recycled one at a time, leaving the last one of the array in front
+    scroll(0.0f);
+    for(unsigned int i = 1; i < TRACK_CHUNKS; ++i)
+        scroll(TRACK_CHUNK_LENGTH + 0.1f);
+    // recycles the last chunk of the array and then the first one in the same call
+    scroll(2.0f * TRACK_CHUNK_LENGTH);
+    // and a few steps long enough to recycle the whole ring at once
+    for(unsigned int i = 0; i < 8; ++i)
+        scroll(TRACK_CHUNKS * TRACK_CHUNK_LENGTH + 1.0f);
+
+    return ordered ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// Packs files into one archive for the game, see rg/AssetPack.hpp for the layout.
+//
+//  asset_packer [-c] output.pack path...
+//
+// Directories are walked recursively. Entries are named by the path they were found under,
+// so running it from the game directory with "resources" gives the names the game loads by.
+// With -c an entry is compressed when that saves at least a quarter of it, everything else is
+// stored so the game can use it in place.
+#include "rg/AssetPack.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct PackInput {
+    std::string name;
+    std::vector<char> payload;
+    uint64_t rawSize;
+    uint16_t flags;
+};
+
+void collectFiles(const std::string& path, std::vector<std::string>& files){
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0){
+        std::cerr << "ERROR::ASSET_PACKER could not find " << path << std::endl;
+        return;
+    }
+    if(!S_ISDIR(info.st_mode)){
+        files.push_back(path);
+        return;
+    }
+    DIR* directory = opendir(path.c_str());
+    if(!directory)
+        return;
+    while(dirent* item = readdir(directory)){
+        if(item->d_name[0] == '.')
+            continue;
+        collectFiles(path + '/' + item->d_name, files);
+    }
+    closedir(directory);
+}
+
+bool readInput(const std::string& path, bool compress, PackInput& input){
+    MappedFile file;
+    // empty files can't be mapped but are still valid entries
+    file.open(path);
+    input.name = path;
+    input.rawSize = file.size();
+    input.flags = 0;
+    if(compress && file.size() > 0){
+        PackCodec::compress(file.data(), file.size(), input.payload);
+        std::vector<char> check(file.size());
+        if(!PackCodec::decompress(input.payload.data(), input.payload.size(), check.data(), check.size())
+           || std::memcmp(check.data(), file.data(), file.size()) != 0){
+            std::cerr << "ERROR::ASSET_PACKER compressing " << path << " does not round trip" << std::endl;
+            return false;
+        }
+        if(input.payload.size() <= file.size() - file.size() / 4){
+            input.flags = PACK_COMPRESSED;
+            return true;
+        }
+    }
+    input.payload.assign(file.data(), file.data() + file.size());
+    return true;
+}
+
+int main(int argc, char** argv){
+    bool compress = argc > 1 && std::strcmp(argv[1], "-c") == 0;
+    int first = compress ? 2 : 1;
+    if(argc - first < 2){
+        std::cerr << "usage: asset_packer [-c] output.pack path..." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    for(int i = first + 1; i < argc; ++i)
+        collectFiles(argv[i], files);
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    std::vector<PackInput> inputs(files.size());
+    for(size_t i = 0; i < files.size(); ++i){
+        if(files[i].size() > 0xFFFF){
+            std::cerr << "ERROR::ASSET_PACKER name too long: " << files[i] << std::endl;
+            return 1;
+        }
+        if(!readInput(files[i], compress, inputs[i]))
+            return 1;
+    }
+
+    std::vector<PackEntry> entries(inputs.size());
+    std::string names;
+    for(size_t i = 0; i < inputs.size(); ++i){
+        entries[i].nameOffset = names.size();
+        entries[i].nameLength = inputs[i].name.size();
+        names += inputs[i].name;
+    }
+    uint64_t offset = 4 * sizeof(uint32_t) + entries.size() * sizeof(PackEntry) + names.size();
+    for(size_t i = 0; i < inputs.size(); ++i){
+        offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+        entries[i].offset = offset;
+        entries[i].size = inputs[i].payload.size();
+        entries[i].rawSize = inputs[i].rawSize;
+        entries[i].flags = inputs[i].flags;
+        offset += entries[i].size;
+    }
+
+    std::ofstream out(argv[first], std::ios::binary | std::ios::trunc);
+    if(!out){
+        std::cerr << "ERROR::ASSET_PACKER could not write " << argv[first] << std::endl;
+        return 1;
+    }
+    uint32_t header[4] = {PACK_MAGIC, PACK_VERSION, (uint32_t)entries.size(), (uint32_t)names.size()};
+    out.write((const char*)header, sizeof(header));
+    out.write((const char*)entries.data(), entries.size() * sizeof(PackEntry));
+    out.write(names.data(), names.size());
+    uint64_t written = sizeof(header) + entries.size() * sizeof(PackEntry) + names.size();
+    uint64_t stored = 0;
+    for(size_t i = 0; i < inputs.size(); ++i){
+        static const char padding[PACK_ALIGNMENT] = {};
+        out.write(padding, entries[i].offset - written);
+        out.write(inputs[i].payload.data(), inputs[i].payload.size());
+        written = entries[i].offset + entries[i].size;
+        stored += inputs[i].rawSize;
+    }
+    if(!out){
+        std::cerr << "ERROR::ASSET_PACKER writing " << argv[first] << " failed" << std::endl;
+        return 1;
+    }
+    std::cout << entries.size() << " files, " << stored << " bytes packed into " << written << std::endl;
+    return 0;
+}